@@ -33,6 +33,7 @@ if(NOT LOG_LEVEL)
     set(LOG_LEVEL LogLevelDebug)
 endif()
 
+set(RUNTIME_LOG_LEVEL "" CACHE STRING "Set the log level a process starts with, LOG_LEVEL if empty")
 
 # Check if using MSVC
 if(MSVC)
@@ -53,6 +54,9 @@ set(gcc_like_cxx "$<COMPILE_LANG_AND_ID:CXX,ARMClang,AppleClang,Clang,GNU,LCC>")
 set(msvc_cxx "$<COMPILE_LANG_AND_ID:CXX,MSVC>")
 
 target_compile_options(compiler_flags INTERFACE -DLOG_LEVEL=${LOG_LEVEL})
+if(RUNTIME_LOG_LEVEL)
+    target_compile_options(compiler_flags INTERFACE -DRUNTIME_LOG_LEVEL=${RUNTIME_LOG_LEVEL})
+endif()
 
 # set(CMAKE_C_FLAGS_RELEASE "${CMAKE_C_FLAGS_RELEASE} -DLOG_LEVEL=${LOG_LEVEL}")
 # set(CMAKE_CXX_FLAGS_RELEASE "${CMAKE_CXX_FLAGS_RELEASE} -DLOG_LEVEL=${LOG_LEVEL}")
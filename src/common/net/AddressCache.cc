@@ -15,29 +15,191 @@
  */
 
 #include "AddressCache.hh"
+#include <string.h>
 
 namespace net
 {
 
+#define SHARD_CAPACITY (ADDRESS_CACHE_MAX_ENTRIES / ADDRESS_CACHE_SHARDS)
+
+static bool
+sameAddress(const sock_addrinfo &a, const sock_addrinfo &b)
+{
+    return a.family == b.family && a.addrlen == b.addrlen
+            && memcmp(&a.addr, &b.addr, a.addrlen) == 0;
+}
+
+AddressCache::AddressCache():
+            ttlMs(ADDRESS_CACHE_DEFAULT_TTL_MS),
+            negativeTtlMs(ADDRESS_CACHE_NEGATIVE_TTL_MS),
+            hits(0),
+            negativeHits(0),
+            misses(0),
+            expired(0),
+            evicted(0),
+            invalidated(0)
+{
+}
+
+std::shared_ptr<AddressCache>
+AddressCache::GetInstance()
+{
+    std::call_once(instanceFlag, [] {
+        instance = std::shared_ptr<AddressCache>(new AddressCache());
+    });
+    return instance;
+}
+
+AddressCache::Result
+AddressCache::Lookup(tString host, tString port, bool tcp, std::vector<sock_addrinfo> &addresses)
+{
+    auto key = tKey(host, port, tcp);
+    auto &shard = shardFor(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return Result::Miss;
+    }
+
+    auto entry = it->second;
+    if (entry->expiry <= std::chrono::steady_clock::now()) {
+        shard.lru.erase(entry);
+        shard.index.erase(it);
+        expired.fetch_add(1, std::memory_order_relaxed);
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return Result::Miss;
+    }
+
+    shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+
+    if (entry->addresses.empty()) {
+        negativeHits.fetch_add(1, std::memory_order_relaxed);
+        return Result::NegativeHit;
+    }
+
+    hits.fetch_add(1, std::memory_order_relaxed);
+    addresses = entry->addresses;
+    return Result::Hit;
+}
 
 std::optional<sock_addrinfo>
 AddressCache::GetAddrInfo(tString host, tString port, bool tcp)
 {
-    auto key = std::tuple(host, port, tcp);
-    if (addrInfoMap.find(key) == addrInfoMap.end())
+    std::vector<sock_addrinfo> addresses;
+    if (Lookup(host, port, tcp, addresses) != Result::Hit)
         return std::nullopt;
-    return addrInfoMap[key];
+    return addresses.front();
 }
 
 void
 AddressCache::SetAddrInfo(tString host, tString port, bool tcp, sock_addrinfo addr)
 {
-    auto key = std::tuple(host, port, tcp);
+    auto key = tKey(host, port, tcp);
+    auto &shard = shardFor(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
     addr.cached = 1;
-    addrInfoMap[key] = addr;
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        insert(shard, key, {addr});
+        return;
+    }
+
+    auto &addresses = it->second->addresses;
+    for (auto i = addresses.begin(); i != addresses.end(); i++) {
+        if (sameAddress(*i, addr)) {
+            addresses.erase(i);
+            break;
+        }
+    }
+    addresses.insert(addresses.begin(), addr);
+    if (addresses.size() == 1) //it was a negative entry
+        it->second->expiry = std::chrono::steady_clock::now() + std::chrono::milliseconds(ttlMs.load(std::memory_order_relaxed));
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+}
+
+void
+AddressCache::SetAddresses(tString host, tString port, bool tcp, std::vector<sock_addrinfo> addresses)
+{
+    auto key = tKey(host, port, tcp);
+    auto &shard = shardFor(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+
+    for (auto &addr : addresses)
+        addr.cached = 1;
+    insert(shard, key, addresses);
+}
+
+void
+AddressCache::Invalidate(tString host, tString port, bool tcp)
+{
+    auto key = tKey(host, port, tcp);
+    auto &shard = shardFor(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end())
+        return;
+    shard.lru.erase(it->second);
+    shard.index.erase(it);
+    invalidated.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+AddressCache::Clear()
+{
+    for (auto &shard : shards) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.index.clear();
+        shard.lru.clear();
+    }
+}
+
+AddressCacheStats
+AddressCache::GetStats()
+{
+    AddressCacheStats stats;
+    stats.Hits          = hits.load(std::memory_order_relaxed);
+    stats.NegativeHits  = negativeHits.load(std::memory_order_relaxed);
+    stats.Misses        = misses.load(std::memory_order_relaxed);
+    stats.Expired       = expired.load(std::memory_order_relaxed);
+    stats.Evicted       = evicted.load(std::memory_order_relaxed);
+    stats.Invalidated   = invalidated.load(std::memory_order_relaxed);
+    return stats;
+}
+
+AddressCache::Shard &
+AddressCache::shardFor(const tKey &key)
+{
+    auto hash = std::hash<tString>{}(std::get<0>(key)) ^ (std::hash<tString>{}(std::get<1>(key)) << 1);
+    return shards[hash % ADDRESS_CACHE_SHARDS];
+}
+
+void
+AddressCache::insert(Shard &shard, tKey key, std::vector<sock_addrinfo> addresses)
+{
+    //shard lock is held by the caller
+    auto ttl = addresses.empty() ? negativeTtlMs.load(std::memory_order_relaxed) : ttlMs.load(std::memory_order_relaxed);
+    shard.lru.push_front(Entry{key, addresses, std::chrono::steady_clock::now() + std::chrono::milliseconds(ttl)});
+    shard.index[key] = shard.lru.begin();
+
+    while (shard.lru.size() > SHARD_CAPACITY) {
+        shard.index.erase(shard.lru.back().key);
+        shard.lru.pop_back();
+        evicted.fetch_add(1, std::memory_order_relaxed);
+    }
 }
 
 std::shared_ptr<AddressCache> AddressCache::instance = nullptr;
+std::once_flag AddressCache::instanceFlag;
 
 } // namespace net
 
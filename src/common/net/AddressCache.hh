@@ -21,42 +21,128 @@
 #include <platform/network.h>
 #include <platform/SharedPtr.hh>
 #include <map>
+#include <list>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 #include <optional>
 
 namespace net
 {
 
+#define ADDRESS_CACHE_SHARDS                16
+#define ADDRESS_CACHE_MAX_ENTRIES           1024
+#define ADDRESS_CACHE_DEFAULT_TTL_MS        (300*1000)
+#define ADDRESS_CACHE_NEGATIVE_TTL_MS       (5*1000)
+
+struct AddressCacheStats
+{
+    tUint64                     Hits;
+    tUint64                     NegativeHits;
+    tUint64                     Misses;
+    tUint64                     Expired;
+    tUint64                     Evicted;
+    tUint64                     Invalidated;
+};
+
+/*
+ * Process wide cache of resolved names. It keeps every address returned for a
+ * name, the one that connected last goes first. getaddrinfo does not report
+ * the record TTL, so entries live for a fixed time. Failed lookups are cached
+ * for a shorter time. Entries are spread over mutex protected shards, each
+ * with its own LRU list, so that threads rarely wait for each other.
+ */
 class AddressCache: virtual public pinggy::SharedObject
 {
 public:
+    enum class Result {
+        Miss,
+        Hit,
+        NegativeHit
+    };
+
     // Delete copy constructor and assignment operator to prevent copies
     AddressCache(const AddressCache&) = delete;
     AddressCache& operator=(const AddressCache&) = delete;
 
-    // Static method to access the single instance
-    static std::shared_ptr<AddressCache> GetInstance()
-    {
-        if (!AddressCache::instance)
-            AddressCache::instance = std::shared_ptr<AddressCache>(new AddressCache()); // Guaranteed to be thread-safe in C++11+
-        return AddressCache::instance;
-    }
+    static std::shared_ptr<AddressCache>
+    GetInstance();
+
+    // All the cached addresses, the preferred one first.
+    Result
+    Lookup(tString host, tString port, bool tcp, std::vector<sock_addrinfo> &addresses);
 
+    // Preferred address only.
     std::optional<sock_addrinfo>
     GetAddrInfo(tString host, tString port, bool tcp = true);
 
+    // Marks an address as the preferred one, adds it if required.
     void
     SetAddrInfo(tString host, tString port, bool tcp, sock_addrinfo addr);
 
+    // Replaces the addresses of a name. An empty list is a negative entry.
+    void
+    SetAddresses(tString host, tString port, bool tcp, std::vector<sock_addrinfo> addresses);
+
+    // Forget the name, i.e. the cached address did not work.
+    void
+    Invalidate(tString host, tString port, bool tcp = true);
+
+    void
+    SetTtl(tUint64 ttlMs, tUint64 negativeTtlMs)
+                                { this->ttlMs = ttlMs; this->negativeTtlMs = negativeTtlMs; }
+
+    void
+    Clear();
+
+    AddressCacheStats
+    GetStats();
+
     DefineMandatoryClassFunctionsWOSuper(AddressCache);
 
 private:
-    AddressCache()              { }
+    typedef std::tuple<tString, tString, bool>
+                                tKey;
+    typedef std::chrono::steady_clock::time_point
+                                tTimePoint;
+
+    struct Entry {
+        tKey                    key;
+        std::vector<sock_addrinfo>
+                                addresses;
+        tTimePoint              expiry;
+    };
+
+    struct Shard {
+        std::mutex              lock;
+        std::list<Entry>        lru; //most recently used first
+        std::map<tKey, std::list<Entry>::iterator>
+                                index;
+    };
+
+    AddressCache();
+
+    Shard &
+    shardFor(const tKey &key);
+
+    void
+    insert(Shard &shard, tKey key, std::vector<sock_addrinfo> addresses);
+
+    Shard                       shards[ADDRESS_CACHE_SHARDS];
+    std::atomic<tUint64>        ttlMs;
+    std::atomic<tUint64>        negativeTtlMs;
 
-    std::map<std::tuple<tString, tString, bool>, sock_addrinfo>
-                                addrInfoMap;
+    std::atomic<tUint64>        hits;
+    std::atomic<tUint64>        negativeHits;
+    std::atomic<tUint64>        misses;
+    std::atomic<tUint64>        expired;
+    std::atomic<tUint64>        evicted;
+    std::atomic<tUint64>        invalidated;
 
     static std::shared_ptr<AddressCache>
                                 instance;
+    static std::once_flag       instanceFlag;
 };
 DefineMakeSharedPtr(AddressCache);
 
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AsyncResolver.hh"
+#include <platform/Log.hh>
+
+namespace net
+{
+
+/*
+ * The part of a resolver the worker threads may touch. A worker holds it
+ * until its lookup is queued, so it may outlive the resolver; `closed` tells
+ * it that nobody waits for the result anymore.
+ */
+struct AsyncResolver::Mailbox
+{
+    Mailbox(sock_t pollFd, sock_t notificationFd):
+            closed(false),
+            pollFd(pollFd),
+            notificationFd(notificationFd)
+                                { }
+
+    ~Mailbox()
+    {
+        CloseNCleanSocket(pollFd);
+        CloseNCleanSocket(notificationFd);
+    }
+
+    std::mutex                  lock;
+    bool                        closed;
+    sock_t                      pollFd;
+    sock_t                      notificationFd;
+    std::queue<std::tuple<tResolveKey, std::vector<sock_addrinfo>>>
+                                completedLookups;
+};
+
+AsyncResolver::AsyncResolver(common::PollControllerPtr pollController):
+            pollController(pollController),
+            stopped(false)
+{
+}
+
+AsyncResolver::~AsyncResolver()
+{
+    //The poll controller holds us while we are registered, it is gone already
+    closeMailbox();
+}
+
+void
+AsyncResolver::Resolve(tString host, tString port, ResolveCallback callback)
+{
+    if (stopped)
+        throw std::runtime_error("Resolver is stopped");
+
+    auto key = tResolveKey(host, port);
+    auto it = pendingLookups.find(key);
+    if (it != pendingLookups.end()) {
+        LOGT("Joining pending lookup for ", host, port);
+        it->second.push_back(callback);
+        return;
+    }
+
+    if (!mailbox && !openMailbox())
+        throw std::runtime_error("Could not create resolver notification channel");
+
+    pendingLookups[key].push_back(callback);
+    auto mailbox = this->mailbox;
+    sharedThreadPool()->QueueJob([mailbox, key]() { resolveInsideThread(mailbox, key); });
+}
+
+void
+AsyncResolver::Stop()
+{
+    if (stopped)
+        return;
+    stopped = true;
+
+    if (mailbox)
+        pollController->DeregisterHandler(thisPtr);
+    closeMailbox(); //an ongoing getaddrinfo finishes on its own, queued lookups are dropped
+    pendingLookups.clear();
+    pollController = nullptr;
+}
+
+sock_t
+AsyncResolver::GetFd()
+{
+    return mailbox ? mailbox->pollFd : InValidSocket;
+}
+
+len_t
+AsyncResolver::HandlePollRecv()
+{
+    char buf[100];
+    if (app_recv(mailbox->pollFd, buf, sizeof(buf), 0) <= 0) {
+        LOGE("Resolver notification channel closed");
+    }
+
+    std::queue<std::tuple<tResolveKey, std::vector<sock_addrinfo>>> completedLookups;
+    {
+        std::lock_guard<std::mutex> guard(mailbox->lock);
+        completedLookups.swap(mailbox->completedLookups);
+    }
+
+    //A callback may stop the resolver, the rest are dropped by the lookup below
+    while (!completedLookups.empty()) {
+        tResolveKey key;
+        std::vector<sock_addrinfo> addresses;
+        std::tie(key, addresses) = completedLookups.front();
+        completedLookups.pop();
+
+        auto it = pendingLookups.find(key);
+        if (it == pendingLookups.end())
+            continue;
+
+        auto callbacks = it->second;
+        pendingLookups.erase(it);
+
+        LOGT("Resolved ", std::get<0>(key), "to", addresses.size(), "addresses for", callbacks.size(), "waiters");
+        for (auto callback : callbacks)
+            callback(addresses);
+    }
+    return 0;
+}
+
+len_t
+AsyncResolver::HandlePollError(int16_t)
+{
+    LOGE("Resolver notification channel failed");
+    return 0;
+}
+
+common::ThreadPoolPtr
+AsyncResolver::sharedThreadPool()
+{
+    //Started with the first lookup missing the AddressCache and never stopped,
+    // the threads end with the process.
+    static std::once_flag started;
+    static common::ThreadPoolPtr *threadPool = nullptr;
+    std::call_once(started, []() {
+        threadPool = new common::ThreadPoolPtr(common::NewThreadPoolPtr());
+        (*threadPool)->Start(ASYNC_RESOLVER_THREADS);
+    });
+    return *threadPool;
+}
+
+void
+AsyncResolver::resolveInsideThread(tMailboxPtr mailbox, tResolveKey key)
+{
+    //This runs in the worker thread. It must not touch anything but the mailbox.
+    {
+        std::lock_guard<std::mutex> guard(mailbox->lock);
+        if (mailbox->closed)
+            return;
+    }
+
+    std::vector<sock_addrinfo> addresses;
+    auto [host, port] = key;
+    auto result = app_getaddrinfo_tcp(host.c_str(), port.c_str());
+    for (auto addr = result; addr && addr->valid; addr++)
+        addresses.push_back(*addr);
+    app_freeaddrinfo(result);
+
+    std::lock_guard<std::mutex> guard(mailbox->lock);
+    if (mailbox->closed)
+        return;
+    mailbox->completedLookups.push(std::make_tuple(key, addresses));
+    if (app_send(mailbox->notificationFd, "1", 1, 0) <= 0) {
+        LOGE("Could not notify resolver");
+    }
+}
+
+bool
+AsyncResolver::openMailbox()
+{
+    sock_t fds[2];
+    if (app_socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        LOGE("Could not create resolver notification channel");
+        return false;
+    }
+    mailbox = std::make_shared<Mailbox>(fds[0], fds[1]);
+    pollController->RegisterHandler(thisPtr);
+    return true;
+}
+
+void
+AsyncResolver::closeMailbox()
+{
+    if (!mailbox)
+        return;
+    {
+        std::lock_guard<std::mutex> guard(mailbox->lock);
+        mailbox->closed = true;
+    }
+    mailbox = nullptr;
+}
+
+} // namespace net
+
+INCLUDE_MEMORY_DUMP_DEFINITION
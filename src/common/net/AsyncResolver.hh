@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SRC_COMMON_NET_ASYNCRESOLVER_HH__
+#define __SRC_COMMON_NET_ASYNCRESOLVER_HH__
+
+#include <platform/platform.h>
+#include <platform/network.h>
+#include <platform/SharedPtr.hh>
+#include <poll/ThreadPool.hh>
+#include <functional>
+#include <vector>
+#include <queue>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#define ASYNC_RESOLVER_THREADS 2
+
+namespace net
+{
+
+DeclareClassWithSharedPtr(AsyncResolver);
+
+/*
+ * Runs getaddrinfo on a thread pool shared by every resolver of the process
+ * and reports the result back on the poll thread. Callbacks are never called
+ * from inside Resolve(). Concurrent lookups of the same host and port share a
+ * single getaddrinfo call.
+ *
+ * One resolver serves one PollController and, except for the worker threads,
+ * must only be used from that poll controller's thread. It owns no thread,
+ * only a socket pair that wakes its poll controller, created with the first
+ * lookup.
+ */
+class AsyncResolver: public common::PollEventHandler
+{
+public:
+    typedef std::function<void(std::vector<sock_addrinfo> addresses)>
+                                ResolveCallback;
+
+    AsyncResolver(common::PollControllerPtr pollController);
+
+    virtual
+    ~AsyncResolver();
+
+    // Empty address list means the lookup failed.
+    void
+    Resolve(tString host, tString port, ResolveCallback callback);
+
+    // Pending callbacks are dropped.
+    void
+    Stop();
+
+    //common::PollEventHandler
+    virtual sock_t
+    GetFd() override;
+
+    virtual len_t
+    HandlePollRecv() override;
+
+    virtual len_t
+    HandlePollError(int16_t) override;
+
+    DefineMandatoryClassFunctionsWOSuper(AsyncResolver);
+
+private:
+    typedef std::tuple<tString, tString>
+                                tResolveKey;
+
+    struct Mailbox;
+    typedef std::shared_ptr<Mailbox>
+                                tMailboxPtr;
+
+    static common::ThreadPoolPtr
+    sharedThreadPool();
+
+    static void
+    resolveInsideThread(tMailboxPtr mailbox, tResolveKey key);
+
+    bool
+    openMailbox();
+
+    void
+    closeMailbox();
+
+    common::PollControllerPtr   pollController;
+    bool                        stopped;
+
+    std::map<tResolveKey, std::vector<ResolveCallback>>
+                                pendingLookups;
+
+    tMailboxPtr                 mailbox; // shared with the worker threads
+};
+DefineMakeSharedPtr(AsyncResolver);
+
+} // namespace net
+
+#endif // __SRC_COMMON_NET_ASYNCRESOLVER_HH__
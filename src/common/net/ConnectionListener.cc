@@ -221,6 +221,7 @@ ConnectionListenerImpl::Accept()
     LOGD("New connection accepted", netConn);
     netConn->SetFlags(flagsForChild);
     netConn->SetConnType(ConnTypeForChild());
+    netConn->ApplySocketTuning(SocketTuningForChild());
     netConn->SetBlocking(true);
     netConn->SetPollController(GetPollController());
     return netConn;
@@ -149,12 +149,22 @@ public:
     virtual void
     SetConnTypeForChild(tConnType connType) final
                                 { this->connTypeForChild = connType; }
+
+    virtual const SocketTuning &
+    SocketTuningForChild() final
+                                { return socketTuningForChild; }
+
+    //Socket options applied to every accepted connection
+    virtual void
+    SetSocketTuningForChild(const SocketTuning &tuning) final
+                                { this->socketTuningForChild = tuning; }
 private:
     ConnectionListenerHandlerPtr
                                 eventHandler;
     len_t                       maxSeqAccepts;
     bool                        acceptRawSocket;
     tConnType                   connTypeForChild;
+    SocketTuning                socketTuningForChild;
 };
 DeclareSharedPtr(ConnectionListener);
 
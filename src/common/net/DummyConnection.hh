@@ -104,6 +104,10 @@ public:
                     int keepIntvl, bool enable) override
                                 { return false; }
 
+    virtual bool
+    ApplySocketTuning(const SocketTuning &tuning) override
+                                { return false; }
+
     virtual int
     SslError(int ret) override;
 
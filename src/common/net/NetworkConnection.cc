@@ -21,9 +21,12 @@
 
 #include <platform/Log.hh>
 #include <string.h>
+#include <deque>
+#include <algorithm>
 #include <utils/Json.hh>
 #include <platform/platform.h>
 #include "AddressCache.hh"
+#include "AsyncResolver.hh"
 
 
 namespace net {
@@ -77,6 +80,7 @@ NetworkConnectionImpl::NetworkConnectionImpl(tString host, tString port, bool bl
         connecting(false),
         cachedAddressTried(false),
         fetchAddressFromSystem(false),
+        resolving(false),
         hostToConnect(host),
         portToConnect(port)
 {
@@ -106,7 +110,8 @@ NetworkConnectionImpl::NetworkConnectionImpl(tString path) :
         tryAgain(false),
         connecting(false),
         cachedAddressTried(false),
-        fetchAddressFromSystem(false)
+        fetchAddressFromSystem(false),
+        resolving(false)
 {
     bzero(&currentAddress, sizeof(currentAddress));
     auto sock = app_uds_client_connect(path.c_str());
@@ -133,7 +138,8 @@ NetworkConnectionImpl::NetworkConnectionImpl(sock_t fd) :
         tryAgain(false),
         connecting(false),
         cachedAddressTried(false),
-        fetchAddressFromSystem(false)
+        fetchAddressFromSystem(false),
+        resolving(false)
 {
     bzero(&currentAddress, sizeof(currentAddress));
     soType = get_socket_type(fd);
@@ -155,7 +161,8 @@ NetworkConnectionImpl::NetworkConnectionImpl(sock_t fd, SocketAddressPtr peerAdd
         tryAgain(false),
         connecting(false),
         cachedAddressTried(false),
-        fetchAddressFromSystem(false)
+        fetchAddressFromSystem(false),
+        resolving(false)
 {
     bzero(&currentAddress, sizeof(currentAddress));
     soType = get_socket_type(fd);
@@ -224,6 +231,7 @@ int
 NetworkConnectionImpl::CloseNClear(tString location)
 {
     int ret = 0;
+    cancelConnectAttempts();
     if(IsValidSocket(fd)) {
         LOGD(this, location, "Closing connection:", thisPtr);
         ret = SysSocketClose(fd);
@@ -233,86 +241,187 @@ NetworkConnectionImpl::CloseNClear(tString location)
     return ret;
 }
 
-len_t
-NetworkConnectionImpl::HandleConnect()
+/*
+ * One in-flight non-blocking connect of a NetworkConnectionImpl. The owner may
+ * run several of these in parallel (Happy Eyeballs). The socket is handed over
+ * to the owner once it connects.
+ */
+class ConnectAttempt: public common::PollEventHandler
 {
-    DeregisterConnectHandler();
-    if (connectTimer) {
-        connectTimer->DisArm();
-        connectTimer = nullptr;
-        LOGT("DisArming timer: fd:", fd);
-    }
-    int err;
-    socklen_t len = sizeof(err);
-    if (app_getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
-        CloseNCleanSocket(fd);
-        LOGT("Failed to connect");
-        netState.Valid = false;
-        tryNonBlockingConnect();
-        return 0;
-    }
+public:
+    ConnectAttempt(NetworkConnectionImplPtr owner, sock_t fd, sock_addrinfo address):
+                                owner(owner), fd(fd), address(address), registered(false)
+                                { }
 
-    if (err == 0) {
-        netState.Connected = true;
+    virtual
+    ~ConnectAttempt()           { CloseNCleanSocket(fd); }
 
-        soType = get_socket_type(fd);
-        soFamily = get_socket_family(fd);
-        netState.Tcp = (soFamily == AF_INET || soFamily == AF_INET6) && soType == SOCK_STREAM;
-        netState.Uds = soFamily == AF_UNIX;
+    void
+    Start(common::PollControllerPtr pollController, tDuration timeout);
 
-        connectEventHandler->HandleConnected(thisPtr);
-        connectEventHandler = nullptr;
-        connectEventPtr     = nullptr;
-        connectEventTag     = "";
+    // Stops polling and returns the socket, the caller owns it.
+    sock_t
+    Release();
 
-        if (!currentAddress.cached) {
-            AddressCache::GetInstance()->SetAddrInfo(hostToConnect, portToConnect, true, currentAddress);
-        }
-    } else {
-        LOGT("Failed to connect");
-        CloseNCleanSocket(fd);
-        netState.Valid = false;
-        tryNonBlockingConnect();
+    void
+    Cancel()                    { auto sock = Release(); CloseNCleanSocket(sock); }
+
+    const sock_addrinfo &
+    GetAddress()                { return address; }
+
+    virtual sock_t
+    GetFd() override            { return fd; }
+
+    virtual len_t
+    HandlePollRecv() override   { return checkConnection(); }
+
+    virtual len_t
+    HandlePollSend() override   { return checkConnection(); }
+
+    virtual len_t
+    HandlePollError(int16_t) override
+                                { return checkConnection(); }
+
+    DefineMandatoryClassFunctionsWOSuper(ConnectAttempt);
+
+private:
+    len_t
+    checkConnection();
+
+    void
+    timedOut();
+
+    NetworkConnectionImplWPtr   owner;
+    sock_t                      fd;
+    sock_addrinfo               address;
+    bool                        registered;
+    common::PollControllerPtr   pollController;
+    common::PollableTaskPtr     timer;
+};
+DefineMakeSharedPtr(ConnectAttempt);
+
+void
+ConnectAttempt::Start(common::PollControllerPtr pollController, tDuration timeout)
+{
+    this->pollController = pollController;
+    pollController->RegisterHandler(thisPtr, false);
+    pollController->DisableReader(thisPtr);
+    pollController->EnableWriter(thisPtr);
+    registered = true;
+    timer = pollController->SetTimeout(timeout, thisPtr, &ConnectAttempt::timedOut);
+    LOGT("Connect attempt started: fd:", fd, (address.family == AF_INET6 ? "IPv6" : "IPv4"));
+}
+
+sock_t
+ConnectAttempt::Release()
+{
+    if (timer) {
+        timer->DisArm();
+        timer = nullptr;
     }
-    return 0;
+    if (registered) {
+        pollController->DeregisterHandler(thisPtr);
+        registered = false;
+    }
+    pollController = nullptr;
+    auto sock = fd;
+    InValidateSocket(fd);
+    return sock;
 }
 
 len_t
-NetworkConnectionImpl::HandleConnectError(tInt16 err)
+ConnectAttempt::checkConnection()
 {
-    LOGD("Connect error occurred");
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (app_getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+        err = app_get_errno();
+
+    auto netConn = owner.lock();
+    if (!netConn) {
+        Cancel();
+        return 0;
+    }
+    netConn->connectAttemptFinished(thisPtr, err == 0);
     return 0;
 }
 
+void
+ConnectAttempt::timedOut()
+{
+    timer = nullptr;
+    LOGT("Timeout to connect: fd: ", fd);
+    auto netConn = owner.lock();
+    if (!netConn) {
+        Cancel();
+        return;
+    }
+    netConn->connectAttemptFinished(thisPtr, false);
+}
+
+//Prefer the first family, but alternate them so that a broken family costs
+// one stagger delay only (RFC 8305 section 4).
+static std::vector<sock_addrinfo>
+interleaveFamilies(const std::vector<sock_addrinfo> &addresses)
+{
+    if (addresses.empty())
+        return addresses;
+
+    std::deque<sock_addrinfo> first, other;
+    auto firstFamily = addresses.front().family;
+    for (auto &addr : addresses)
+        (addr.family == firstFamily ? first : other).push_back(addr);
+
+    std::vector<sock_addrinfo> result;
+    while (!first.empty() || !other.empty()) {
+        if (!first.empty()) {
+            result.push_back(first.front());
+            first.pop_front();
+        }
+        if (!other.empty()) {
+            result.push_back(other.front());
+            other.pop_front();
+        }
+    }
+    return result;
+}
+
 void
 NetworkConnectionImpl::tryNonBlockingConnect()
 {
+    if (staggerTimer) {
+        staggerTimer->DisArm();
+        staggerTimer = nullptr;
+    }
+
     while (getNextAddressToConnect()) {
         if (currentAddress.valid == false)
             continue;
 
         int success = 0;
         LOGT("Trying to connect");
-        fd = app_connect_nonblocking_socket(&currentAddress, &success);
-        netState.Valid = IsValidSocket(fd);
-        if (IsValidSocket(fd)) {
-            if (success) {
-                connectEventHandler->HandleConnected(thisPtr);
-                connectEventHandler = nullptr;
-                connectEventPtr     = nullptr;
-                connectEventTag     = "";
-                if (!currentAddress.cached) {
-                    AddressCache::GetInstance()->SetAddrInfo(hostToConnect, portToConnect, true, currentAddress);
-                }
-            } else {
-                RegisterConnectHandler();
-                connectTimer = GetPollController()->SetTimeout(5*SECOND, thisPtr, &NetworkConnectionImpl::connectTimeoutOccured);
-                LOGT("Setting timer: fd:", fd, (currentAddress.family==AF_INET?"IPv6":"IPv4"));
-            }
+        auto sock = app_connect_nonblocking_socket(&currentAddress, &success);
+        if (!IsValidSocket(sock)) {
+            forgetCachedAddress(currentAddress);
+            continue;
+        }
+
+        if (success) {
+            connectionEstablished(sock, currentAddress);
             return;
         }
+
+        auto attempt = NewConnectAttemptPtr(thisPtr, sock, currentAddress);
+        attempt->Start(GetPollController(), CONNECT_ATTEMPT_TIMEOUT);
+        connectAttempts.push_back(attempt);
+        //Give this attempt a head start, then race the next address
+        staggerTimer = GetPollController()->SetTimeout(HAPPY_EYEBALLS_DELAY, thisPtr, &NetworkConnectionImpl::tryNonBlockingConnect);
+        return;
     }
 
+    if (resolving || !connectAttempts.empty()) //we come back here when they finish
+        return;
+
     {
         LOGE("Failed to connect to ", hostToConnect + ":" + portToConnect);
         connecting = false;
@@ -325,14 +434,66 @@ NetworkConnectionImpl::tryNonBlockingConnect()
 }
 
 void
-NetworkConnectionImpl::connectTimeoutOccured()
+NetworkConnectionImpl::connectAttemptFinished(ConnectAttemptPtr attempt, bool success)
 {
-    DeregisterConnectHandler();
-    connectTimer = nullptr;
-    LOGT("Timeout to connect: fd: ", fd);
-    CloseNCleanSocket(fd);
-    netState.Valid = false;
-    tryNonBlockingConnect();
+    auto it = std::find(connectAttempts.begin(), connectAttempts.end(), attempt);
+    if (it == connectAttempts.end()) {
+        attempt->Cancel();
+        return;
+    }
+    connectAttempts.erase(it);
+
+    if (success) {
+        auto address = attempt->GetAddress();
+        connectionEstablished(attempt->Release(), address);
+        return;
+    }
+
+    LOGT("Failed to connect");
+    forgetCachedAddress(attempt->GetAddress());
+    attempt->Cancel();
+    tryNonBlockingConnect(); //no need to wait for the stagger delay
+}
+
+void
+NetworkConnectionImpl::connectionEstablished(sock_t sock, sock_addrinfo address)
+{
+    cancelConnectAttempts();
+
+    fd = sock;
+    netState.Valid = true;
+    netState.Connected = true;
+    connecting = false;
+
+    soType = get_socket_type(fd);
+    soFamily = get_socket_family(fd);
+    netState.Tcp = (soFamily == AF_INET || soFamily == AF_INET6) && soType == SOCK_STREAM;
+    netState.Uds = soFamily == AF_UNIX;
+
+    AddressCache::GetInstance()->SetAddrInfo(hostToConnect, portToConnect, true, address);
+
+    if (!pendingTuning.IsEmpty()) {
+        ApplySocketTuning(pendingTuning);
+        pendingTuning = SocketTuning();
+    }
+
+    auto handler = connectEventHandler;
+    connectEventHandler = nullptr;
+    handler->HandleConnected(thisPtr);
+    connectEventPtr     = nullptr;
+    connectEventTag     = "";
+}
+
+void
+NetworkConnectionImpl::cancelConnectAttempts()
+{
+    if (staggerTimer) {
+        staggerTimer->DisArm();
+        staggerTimer = nullptr;
+    }
+    for (auto attempt : connectAttempts)
+        attempt->Cancel();
+    connectAttempts.clear();
 }
 
 bool
@@ -342,22 +503,43 @@ NetworkConnectionImpl::getNextAddressToConnect()
     if (!cachedAddressTried) {
         cachedAddressTried = true;
         fetchAddressFromSystem = true;
-        auto addrCache = AddressCache::GetInstance();
-        auto cachedAddr = addrCache->GetAddrInfo(hostToConnect, portToConnect, true);
-        if (cachedAddr.has_value()) {
-            currentAddress = cachedAddr.value();
-            return true;
+        std::vector<sock_addrinfo> cachedAddresses;
+        auto result = AddressCache::GetInstance()->Lookup(hostToConnect, portToConnect, true, cachedAddresses);
+        if (result == AddressCache::Result::NegativeHit) {
+            LOGD("Recent lookup of", hostToConnect, "failed, not resolving again");
+            fetchAddressFromSystem = false;
         }
+        for (auto addr : interleaveFamilies(cachedAddresses))
+            addressesToConnect.push(addr);
+    }
+
+    //Ask the system only after every cached address failed, not while one is
+    // still being tried. The finished attempt brings us back here.
+    if (!connectAttempts.empty() && addressesToConnect.empty())
+        return false;
+
+    if (fetchAddressFromSystem && addressesToConnect.empty() && resolver) {
+        fetchAddressFromSystem = false;
+        resolving = true;
+        NetworkConnectionImplWPtr weakThis = thisPtr;
+        resolver->Resolve(hostToConnect, portToConnect, [weakThis](std::vector<sock_addrinfo> addresses) {
+            auto netConn = weakThis.lock();
+            if (netConn)
+                netConn->addressesResolved(addresses);
+        });
+        return false;
     }
 
-    if (fetchAddressFromSystem) {
+    if (fetchAddressFromSystem && addressesToConnect.empty()) {
         fetchAddressFromSystem = false;
+        std::vector<sock_addrinfo> resolved;
         auto addresses = app_getaddrinfo_tcp(hostToConnect.c_str(), portToConnect.c_str());
-        for (auto addr = addresses; addr && addr->valid; addr++) {
-            sock_addrinfo tmpAdr = *addr;
-            addressesToConnect.push(tmpAdr);
-        }
+        for (auto addr = addresses; addr && addr->valid; addr++)
+            resolved.push_back(*addr);
         app_freeaddrinfo(addresses);
+        AddressCache::GetInstance()->SetAddresses(hostToConnect, portToConnect, true, resolved);
+        for (auto addr : interleaveFamilies(resolved))
+            addressesToConnect.push(addr);
     }
 
     if (addressesToConnect.empty())
@@ -368,6 +550,27 @@ NetworkConnectionImpl::getNextAddressToConnect()
     return true;
 }
 
+void
+NetworkConnectionImpl::addressesResolved(std::vector<sock_addrinfo> addresses)
+{
+    resolving = false;
+    AddressCache::GetInstance()->SetAddresses(hostToConnect, portToConnect, true, addresses);
+    if (!connecting || !connectEventHandler)
+        return;
+
+    for (auto addr : interleaveFamilies(addresses))
+        addressesToConnect.push(addr);
+    tryNonBlockingConnect();
+}
+
+void
+NetworkConnectionImpl::forgetCachedAddress(const sock_addrinfo &address)
+{
+    //The name may have moved to a different address; resolve afresh next time.
+    if (address.cached)
+        AddressCache::GetInstance()->Invalidate(hostToConnect, portToConnect, true);
+}
+
 ssize_t
 NetworkConnectionImpl::Peek(void *buf, size_t nbytes)
 {
@@ -588,6 +791,23 @@ NetworkConnectionImpl::EnableKeepAlive(int keepCnt, int keepIdle,
     return res == 1 ? true : false;
 }
 
+bool
+NetworkConnectionImpl::ApplySocketTuning(const SocketTuning &tuning)
+{
+    if (tuning.IsEmpty())
+        return true;
+
+    if (!netState.Valid || !netState.Connected) {
+        pendingTuning = tuning;
+        return true;
+    }
+
+    if (!IsTcp())
+        return false;
+
+    return apply_socket_tuning(fd, &tuning) == 1;
+}
+
 void
 NetworkConnectionImpl::SetBlocking(bool block)
 {
@@ -128,6 +128,10 @@ union tConnType {
 
 static_assert(sizeof(tConnType) == 8, "Size of tConnType must be 8 bytes");
 
+//Delay before racing the next address of a name, RFC 8305 recommends 250ms
+#define HAPPY_EYEBALLS_DELAY            (250*MILLISECOND)
+#define CONNECT_ATTEMPT_TIMEOUT         (5*SECOND)
+
 #define ADDRESS_METADATA_SIZE           128
 #define NETWORK_METADATA_SIZE           512
 #define METADATA_URL_SIZE_RELAY         256
@@ -221,6 +225,18 @@ union tNetState {
 
 };
 
+/*
+ * Socket options for a tcp connection, applied once it is connected or
+ * accepted. Fields left at -1 keep the system default.
+ */
+struct SocketTuning: public socket_tuning {
+    SocketTuning()              { nodelay = sndbuf = rcvbuf = notsent_lowat = quickack = user_timeout = -1; }
+
+    bool
+    IsEmpty() const             { return nodelay < 0 && sndbuf < 0 && rcvbuf < 0 && notsent_lowat < 0
+                                            && quickack < 0 && user_timeout < 0; }
+};
+
 struct SocketStat: public virtual pinggy::SharedObject {
     uint8_t                     Retransmits;
     uint32_t                    Unacked;
@@ -396,6 +412,11 @@ public:
     EnableKeepAlive(int keepCnt, int keepIdle,
                     int keepIntvl, bool enable = true) = 0;
 
+    //Applies the options now if the connection is established, otherwise as
+    // soon as a connect succeeds. false if an option could not be set.
+    virtual bool
+    ApplySocketTuning(const SocketTuning &tuning) = 0;
+
     virtual bool
     ReassigntoLowerFd() = 0;
 
@@ -408,6 +429,11 @@ public:
     virtual bool
     TryAgain() = 0;
 
+    //Push out whatever a layer buffered internally. false means some data is
+    //still pending, check TryAgain() to distinguish it from an error.
+    virtual bool
+    Flush()                     { return true; }
+
     virtual const AddressMetadata //Not required in public
     GetAddressMetadata();
 
@@ -439,6 +465,8 @@ private:
 
 
 DeclareClassWithSharedPtr(NetworkConnectionImpl);
+DeclareClassWithSharedPtr(AsyncResolver);
+DeclareClassWithSharedPtr(ConnectAttempt);
 abstract class NonBlockingConnectEventHandler: public virtual pinggy::SharedObject {
 public:
     virtual
@@ -522,6 +550,9 @@ public:
     virtual bool
     EnableKeepAlive(int keepCnt, int keepIdleSec, int keepIntvl, bool enable = true) override;
 
+    virtual bool
+    ApplySocketTuning(const SocketTuning &tuning) override;
+
     virtual bool
     ReassigntoLowerFd() override
                                 { return ReassigntoLowerFdPtr(&fd); }
@@ -545,6 +576,12 @@ public:
     virtual void
     Connect(NonBlockingConnectEventHandlerPtr handler, pinggy::VoidPtr ptr = nullptr, tString tag = "");
 
+    // Name lookups of the non-blocking connect go through the resolver
+    // instead of blocking the poll thread in getaddrinfo.
+    virtual void
+    SetResolver(AsyncResolverPtr resolver)
+                                { this->resolver = resolver; }
+
     virtual tNetState
     GetState() override         { return netState; }
 
@@ -568,12 +605,6 @@ protected:
     virtual int
     CloseNClear(tString location) override;
 
-    virtual len_t
-    HandleConnect() override;
-
-    virtual len_t
-    HandleConnectError(tInt16 err) override;
-
     virtual EventHandlerForPollableFdPtr
     GetPollEventHandler() override
                                 { return pollEventObject; }
@@ -587,11 +618,23 @@ private:
     tryNonBlockingConnect();
 
     void
-    connectTimeoutOccured();
+    connectAttemptFinished(ConnectAttemptPtr attempt, bool success);
+
+    void
+    connectionEstablished(sock_t sock, sock_addrinfo address);
+
+    void
+    cancelConnectAttempts();
 
     bool
     getNextAddressToConnect();
 
+    void
+    addressesResolved(std::vector<sock_addrinfo> addresses);
+
+    void
+    forgetCachedAddress(const sock_addrinfo &address);
+
     sock_t                      fd;
     int                         soType;
     int                         soFamily;
@@ -605,6 +648,8 @@ private:
     bool                        connecting;
     bool                        cachedAddressTried;
     bool                        fetchAddressFromSystem;
+    bool                        resolving;
+    AsyncResolverPtr            resolver;
     tString                     hostToConnect;
     tString                     portToConnect;
     sock_addrinfo               currentAddress;
@@ -613,11 +658,16 @@ private:
                                 connectEventHandler;
     tString                     connectEventTag;
     pinggy::VoidPtr             connectEventPtr;
-    common::PollableTaskPtr     connectTimer;
+    std::vector<ConnectAttemptPtr>
+                                connectAttempts;
+    common::PollableTaskPtr     staggerTimer;
+    SocketTuning                pendingTuning; //applied when the connect succeeds
     EventHandlerForPollableFdPtr
                                 pollEventObject;
 
     tNetState                   netState;
+
+    friend class ConnectAttempt;
 };
 
 DefineMakeSharedPtr(NetworkConnectionImpl);
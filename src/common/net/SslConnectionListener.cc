@@ -185,6 +185,7 @@ SslConnectionListener::AcceptSsl()
         if(netConn) {
             auto connType = ConnTypeForChild();
             netConn->SetConnType(connType);
+            netConn->ApplySocketTuning(SocketTuningForChild());
             return AcceptSsl(netConn);
         }
         // SSL *ssl;
@@ -403,6 +404,7 @@ SSL_CTX *SslConnectionListener::initServerCTX()
     }
     SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
     SSL_CTX_set_max_proto_version(ctx, TLS1_3_VERSION);
+    SslNetworkConnection::EnableKtls(ctx);
 
     return ctx;
 }
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SslContextCache.hh"
+#include "SslNetworkConnection.hh"
+#include <platform/Log.hh>
+
+namespace net
+{
+
+SslContextCache::~SslContextCache()
+{
+    for (auto entry : contexts)
+        SSL_CTX_free(entry.second);
+    contexts.clear();
+}
+
+std::shared_ptr<SslContextCache>
+SslContextCache::GetInstance()
+{
+    std::call_once(instanceFlag, [] {
+        instance = std::shared_ptr<SslContextCache>(new SslContextCache());
+    });
+    return instance;
+}
+
+SSL_CTX *
+SslContextCache::GetClientContext(int minVersion, int maxVersion, tString pem, std::vector<tString> alpn)
+{
+    //ALPN in wire format: length prefixed protocol names
+    tString alpnWire;
+    for (auto proto : alpn) {
+        if (proto.empty() || proto.length() > 255)
+            continue;
+        alpnWire += (char)proto.length();
+        alpnWire += proto;
+    }
+
+    auto key = std::make_tuple(minVersion, maxVersion, pem, alpnWire);
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto it = contexts.find(key);
+    if (it != contexts.end()) {
+        SSL_CTX_up_ref(it->second);
+        return it->second;
+    }
+
+    auto ctx = SslNetworkConnection::CreateSslContext(minVersion, maxVersion, pem); //throws
+    if (!alpnWire.empty() && SSL_CTX_set_alpn_protos(ctx, (const unsigned char *)alpnWire.c_str(), alpnWire.length()) != 0) {
+        SSL_CTX_free(ctx);
+        throw SslNetworkConnection::NotValidException("Cannot set alpn");
+    }
+
+    LOGD("New client ssl context: ", minVersion, maxVersion, alpn.size());
+    contexts[key] = ctx;
+    SSL_CTX_up_ref(ctx);
+    return ctx;
+}
+
+std::shared_ptr<SslContextCache> SslContextCache::instance = nullptr;
+std::once_flag SslContextCache::instanceFlag;
+
+} // namespace net
+
+INCLUDE_MEMORY_DUMP_DEFINITION
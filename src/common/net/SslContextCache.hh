@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SRC_COMMON_NET_SSLCONTEXTCACHE_HH__
+#define __SRC_COMMON_NET_SSLCONTEXTCACHE_HH__
+
+#include <platform/platform.h>
+#include <platform/SharedPtr.hh>
+#include <openssl/ssl.h>
+#include <map>
+#include <vector>
+#include <mutex>
+
+namespace net
+{
+
+/*
+ * Client side SSL_CTX objects are expensive to build, mostly because the
+ * trust anchor PEM has to be parsed. This cache builds one context per
+ * distinct configuration and shares it between all the connections and
+ * threads. The contexts are never modified once they are in the cache.
+ */
+class SslContextCache: virtual public pinggy::SharedObject
+{
+public:
+    SslContextCache(const SslContextCache&) = delete;
+    SslContextCache& operator=(const SslContextCache&) = delete;
+
+    virtual
+    ~SslContextCache();
+
+    static std::shared_ptr<SslContextCache>
+    GetInstance();
+
+    // Returns a context with a reference for the caller. Free it with SSL_CTX_free.
+    SSL_CTX *
+    GetClientContext(int minVersion, int maxVersion, tString pem, std::vector<tString> alpn = {});
+
+    DefineMandatoryClassFunctionsWOSuper(SslContextCache);
+
+private:
+    SslContextCache()           { }
+
+    std::mutex                  lock;
+    std::map<std::tuple<int, int, tString, tString>, SSL_CTX *>
+                                contexts;
+
+    static std::shared_ptr<SslContextCache>
+                                instance;
+    static std::once_flag       instanceFlag;
+};
+DefineMakeSharedPtr(SslContextCache);
+
+} // namespace net
+
+#endif // __SRC_COMMON_NET_SSLCONTEXTCACHE_HH__
@@ -19,6 +19,8 @@
 #include <platform/Log.hh>
 #include <openssl/err.h>
 #include "SslNetConnBio.hh"
+#include "SslSessionCache.hh"
+#include "SslContextCache.hh"
 
 namespace net {
 
@@ -107,7 +109,10 @@ SslNetworkConnection::SslNetworkConnection(SSL *ssl, sock_t fd):
         privateCtx(false),
         asyncConnectCompleted(true),
         minTlsVersion(TLS1_3_VERSION),
-        maxTlsVersion(TLS1_3_VERSION)
+        maxTlsVersion(TLS1_3_VERSION),
+        writeCoalescing(false),
+        flushScheduled(false),
+        sessionResumption(true)
 {
 }
 
@@ -121,7 +126,10 @@ SslNetworkConnection::SslNetworkConnection(SSL *ssl, NetworkConnectionPtr netCon
         privateCtx(false),
         asyncConnectCompleted(true),
         minTlsVersion(TLS1_3_VERSION),
-        maxTlsVersion(TLS1_3_VERSION)
+        maxTlsVersion(TLS1_3_VERSION),
+        writeCoalescing(false),
+        flushScheduled(false),
+        sessionResumption(true)
 {
     if (netConn == nullptr || !netConn->IsValid())
         throw NotValidException(netConn, "netConn is not valid");
@@ -144,7 +152,10 @@ SslNetworkConnection::SslNetworkConnection(NetworkConnectionPtr netConn, tString
         privateCtx(false),
         asyncConnectCompleted(true),
         minTlsVersion(TLS1_3_VERSION),
-        maxTlsVersion(TLS1_3_VERSION)
+        maxTlsVersion(TLS1_3_VERSION),
+        writeCoalescing(false),
+        flushScheduled(false),
+        sessionResumption(true)
 {
 }
 
@@ -257,6 +268,8 @@ SslNetworkConnection::Connect(SSL_CTX *ctx)
         throw CannotSetSNIException("Cannot set sni");
     }
 
+    offerCachedSession();
+
     // Establish a secure connection
     auto ret = SSL_connect(ssl);
     if (ret <= 0) {
@@ -267,6 +280,8 @@ SslNetworkConnection::Connect(SSL_CTX *ctx)
         throw CannotConnectException("Cannot perform ssl connect: "+ reason);
     }
     connected = true;
+    LOGD("kTLS offload for fd:", netConn->GetFd(), "send:", IsKtlsSendActive(), "recv:", IsKtlsRecvActive());
+    LOGD("Session resumed:", IsSessionResumed());
 }
 
 void
@@ -296,7 +311,8 @@ SslNetworkConnection::ConnectAsync(SslConnectHandlerPtr handler, pinggy::VoidPtr
 
     netConn->SetBlocking(false);
 
-    if (netConn->IsRelayed() || netConn->IsDummy() || 1) {
+    //kTLS needs the plain socket, like Connect()
+    if (netConn->IsRelayed() || netConn->IsDummy()) {
         auto bio = netConnBioNewBio(netConn);
         if (!bio) {
             LOGSSLE("Error while creating bio");
@@ -312,13 +328,14 @@ SslNetworkConnection::ConnectAsync(SslConnectHandlerPtr handler, pinggy::VoidPtr
         LOGSSLE("Cannot set sni");
         throw CannotSetSNIException("Cannot set sni");
     }
+    offerCachedSession();
     this->asyncConnectPtr = asyncConnectPtr;
     asyncConnectHandler = handler;
     // handleFD();
     this->RegisterFDEvenHandler(thisPtr);
     DisableReadPoll();
     EnableWritePoll();
-    LOGE("Async connection started for fd: ", netConn->GetFd());
+    LOGD("Async connection started for fd: ", netConn->GetFd());
 }
 
 #undef CloseAndFreeFailedConnect
@@ -404,6 +421,9 @@ SslNetworkConnection::Write(RawDataPtr rwData, int flags)
     if (!connected || !asyncConnectCompleted)
         throw SslWriteException("Ssl connection is not established");
 
+    if (writeCoalescing)
+        return writeCoalesced(rwData);
+
     if (writeBuffer) {
         if (wroteFromCached)
             ABORT_WITH_MSG("wroteFromCached should not be non-zero");
@@ -477,6 +497,106 @@ SslNetworkConnection::Write(const void *data, size_t len, int flags)
     return writeFromCached();
 }
 
+/*
+    In coalescing mode the caller's data is copied to `stagedData` and reported
+    as written immediately. When it gets flushed, the staged buffer becomes the
+    `writeBuffer`, so a SSL_write retry always sees exactly the same arguments.
+    No new data is accepted until such a pending record is written.
+ */
+ssize_t
+SslNetworkConnection::writeCoalesced(RawDataPtr rwData)
+{
+    if (writeBuffer && writeFromCached() <= 0)
+        return lastReturn;
+
+    if (!stagedData)
+        stagedData = NewRawDataPtr((RawData::tLen)SSL_WRITE_COALESCE_LIMIT);
+
+    auto len = MIN((RawData::tLen)(SSL_WRITE_COALESCE_LIMIT - stagedData->Len), rwData->Len);
+    stagedData->AddData(rwData->GetData(), len);
+
+    if (stagedData->Len >= SSL_WRITE_COALESCE_LIMIT || !pollControllerIfAny()) {
+        //whatever could not be written would be retried by the next write or flush
+        if (!Flush() && !tryAgain && lastReturn <= 0)
+            return lastReturn;
+    }
+
+    if (writeBuffer || (stagedData && stagedData->Len))
+        scheduleFlush();
+
+    tryAgain = false;
+    lastReturn = len;
+    return len;
+}
+
+bool
+SslNetworkConnection::Flush()
+{
+    if (!ssl || !connected || !asyncConnectCompleted)
+        return true;
+
+    if (writeBuffer && writeFromCached() <= 0)
+        return false;
+
+    if (!stagedData || stagedData->Len == 0)
+        return writeBuffer == nullptr;
+
+    writeBuffer = stagedData;
+    stagedData = nullptr;
+    return writeFromCached() > 0 && writeBuffer == nullptr;
+}
+
+SslNetworkConnectionPtr
+SslNetworkConnection::EnableWriteCoalescing(bool enable)
+{
+    if (!enable && (writeBuffer || stagedData))
+        Flush();
+    if (enable && writeBuffer)
+        throw NotValidException(thisPtr, "Cannot enable coalescing with a pending write");
+    writeCoalescing = enable;
+    return thisPtr;
+}
+
+void
+SslNetworkConnection::scheduleFlush()
+{
+    if (flushScheduled)
+        return;
+    auto pollController = pollControllerIfAny();
+    if (!pollController)
+        return;
+    flushScheduled = true;
+    pollController->DeferToEndOfIteration(thisPtr, &SslNetworkConnection::flushAtEndOfIteration);
+}
+
+common::PollControllerPtr
+SslNetworkConnection::pollControllerIfAny()
+{
+    if (!netConn)
+        return nullptr;
+    auto pollHandler = netConn->GetPollEventHandler();
+    return pollHandler ? pollHandler->GetPollController() : nullptr;
+}
+
+void
+SslNetworkConnection::flushAtEndOfIteration()
+{
+    flushScheduled = false;
+    if (Flush())
+        return;
+    if (tryAgain || lastReturn > 0) {
+        EnableWritePoll(); //The owner of the poll handler calls Flush when writable
+        return;
+    }
+
+    //Nobody may write again to see the error, so the owner learns it the same
+    // way it learns about a broken socket.
+    LOGE("Could not flush staged data, closing");
+    auto pollHandler = netConn ? GetPollEventHandler() : nullptr;
+    if (pollHandler)
+        pollHandler->HandlePollError((int16_t)SslError((int)lastReturn));
+}
+
 int
 SslNetworkConnection::SslError(int len)
 {
@@ -486,6 +606,9 @@ SslNetworkConnection::SslError(int len)
 int
 SslNetworkConnection::CloseNClear(tString location)
 {
+    if (ssl && (writeBuffer || stagedData))
+        Flush(); //best effort
+    stagedData = nullptr;
     if(ssl) {
         auto ctx = SSL_get_SSL_CTX(ssl);
         SSL_free(ssl);         /* release SSL state */
@@ -622,19 +745,23 @@ SslNetworkConnection::handleFD()
     auto ret = SSL_connect(ssl);
     switch(ret) {
         case 0:
+            LOGD("SSL connection failed: ", netConn->GetPeerAddress(), netConn->GetFd());
             DeregisterFDEvenHandler();
             asyncConnectHandler->SslConnectionFailed(thisPtr, asyncConnectPtr);
-            netConn->CloseConn();
-            netConn = nullptr;
+            if (netConn) {
+                netConn->CloseConn();
+                netConn = nullptr;
+            }
             // SSL_free(ssl);
-            LOGD("SSL connection failed: ", netConn->GetPeerAddress(), netConn->GetFd());
             return 0;
         case 1:
             connected = true;
             asyncConnectCompleted = true;
+            LOGD("SSL connected: ", netConn->GetPeerAddress(), netConn->GetFd());
+            LOGD("kTLS offload for fd:", netConn->GetFd(), "send:", IsKtlsSendActive(), "recv:", IsKtlsRecvActive());
+            LOGD("Session resumed:", IsSessionResumed());
             DeregisterFDEvenHandler();
             asyncConnectHandler->SslConnected(thisPtr, asyncConnectPtr);
-            LOGD("SSL connected: ", netConn->GetPeerAddress(), netConn->GetFd());
             return 1;
         default:
         {
@@ -669,8 +796,9 @@ SSL_CTX *
 SslNetworkConnection::createCtxIfNotPresent(SSL_CTX *ctx)
 {
     if (!ctx) {
+        //Shared with other connections, we only hold a reference
+        ctx = SslContextCache::GetInstance()->GetClientContext(minTlsVersion, maxTlsVersion, rootCertificate, alpnProtocols);
         privateCtx = true;
-        ctx = SslNetworkConnection::CreateSslContext(minTlsVersion, maxTlsVersion, rootCertificate);
     }
     return ctx;
 }
@@ -697,11 +825,81 @@ SslNetworkConnection::CreateSslContext(int minVersion, int maxVersion, tString c
     }
     SSL_CTX_set_min_proto_version(ctx, minVersion);
     SSL_CTX_set_max_proto_version(ctx, maxVersion);
+    EnableKtls(ctx);
+
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, &SslNetworkConnection::newSessionCallback);
 
     loadBaseCertificate(ctx, certificate);
     return ctx;
 }
 
+void
+SslNetworkConnection::offerCachedSession()
+{
+    if (!sessionResumption || serverSide)
+        return;
+
+    auto peer = netConn->GetPeerAddress();
+    if (!peer || !peer->IsValid())
+        return;
+
+    sessionCacheKey = peer->GetIp() + ":" + std::to_string(peer->GetPort()) + "/" + sniServerName;
+    SSL_set_app_data(ssl, this); //newSessionCallback needs the key
+
+    auto session = SslSessionCache::GetInstance()->Take(sessionCacheKey);
+    if (!session)
+        return;
+
+    if (!SSL_set_session(ssl, session))
+        LOGSSLE("Cannot offer cached session");
+    SSL_SESSION_free(session); //ssl holds its own reference
+}
+
+int
+SslNetworkConnection::newSessionCallback(SSL *ssl, SSL_SESSION *session)
+{
+    auto conn = (SslNetworkConnection *)SSL_get_app_data(ssl);
+    if (!conn || conn->sessionCacheKey.empty())
+        return 0;
+
+    SslSessionCache::GetInstance()->Store(conn->sessionCacheKey, session);
+    return 1; //the cache owns the reference now
+}
+
+/*
+    kTLS works only when the SSL object talks to the socket directly
+    (SSL_set_fd). Relayed and dummy connections use our own BIO and simply
+    keep doing the crypto in user space.
+ */
+void
+SslNetworkConnection::EnableKtls(SSL_CTX *ctx)
+{
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+}
+
+bool
+SslNetworkConnection::IsKtlsSendActive()
+{
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    if (ssl && SSL_get_wbio(ssl))
+        return BIO_get_ktls_send(SSL_get_wbio(ssl));
+#endif
+    return false;
+}
+
+bool
+SslNetworkConnection::IsKtlsRecvActive()
+{
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    if (ssl && SSL_get_rbio(ssl))
+        return BIO_get_ktls_recv(SSL_get_rbio(ssl));
+#endif
+    return false;
+}
+
 } /* namespace net */
 
 INCLUDE_MEMORY_DUMP_DEFINITION
@@ -24,6 +24,8 @@
 
 #include <openssl/ssl.h>
 
+// Maximum plaintext of a single TLS record
+#define SSL_WRITE_COALESCE_LIMIT SSL3_RT_MAX_PLAIN_LENGTH
 
 namespace net {
 
@@ -64,6 +66,21 @@ public:
     SslNetworkConnectionPtr
     SetMaxTlsVersion(int ver)       { maxTlsVersion = ver; return thisPtr; }
 
+    SslNetworkConnectionPtr
+    SetAlpnProtocols(std::vector<tString> protocols)
+                                { alpnProtocols = protocols; return thisPtr; }
+
+    // Offer a cached session to the server and store the ones it issues.
+    // Enabled by default for client connections. There is no 0-RTT: the
+    // first flight to the pinggy server carries the login token, and early
+    // data can be replayed by anyone who captured it.
+    SslNetworkConnectionPtr
+    SetSessionResumption(bool enable)
+                                { sessionResumption = enable; return thisPtr; }
+
+    bool
+    IsSessionResumed()          { return ssl && SSL_session_reused(ssl); }
+
     virtual void
     Connect(SSL_CTX *ctx = NULL) final;
 
@@ -85,6 +102,30 @@ public:
     virtual ssize_t
     Write(RawDataPtr rwData, int flags = 0) override;
 
+    virtual bool
+    Flush() override;
+
+    /**
+     * Stage small writes and encrypt them together as records of up to
+     * SSL_WRITE_COALESCE_LIMIT bytes. The staged data is flushed once the
+     * limit is reached, at the end of the poll iteration or on Flush().
+     * Needs to be enabled before any data is written.
+     */
+    SslNetworkConnectionPtr
+    EnableWriteCoalescing(bool enable = true);
+
+    bool
+    IsWriteCoalescing()         { return writeCoalescing; }
+
+    // Kernel TLS. Once the handshake is done the kernel encrypts and decrypts
+    // the records. These tell whether it actually took over, OpenSSL falls
+    // back to user space crypto when the kernel or the cipher lacks support.
+    bool
+    IsKtlsSendActive();
+
+    bool
+    IsKtlsRecvActive();
+
     virtual ssize_t
     LastReturn() override       { return lastReturn; }
 
@@ -116,6 +157,10 @@ public:
     EnableKeepAlive(int keepCnt, int keepIdle, int keepIntvl, bool enable = true) override
                                 { return (netConn) ? netConn->EnableKeepAlive(keepCnt, keepIdle, keepIntvl, enable) : false; }
 
+    virtual bool
+    ApplySocketTuning(const SocketTuning &tuning) override
+                                { return (netConn) ? netConn->ApplySocketTuning(tuning) : false; }
+
     virtual bool
     ReassigntoLowerFd() override
                                 { return (netConn) ? netConn->ReassigntoLowerFd() : false; }
@@ -198,6 +243,9 @@ CustomeException(Certificate);
     static SSL_CTX *
     CreateSslContext(int minVersion = TLS1_3_VERSION, int maxVersion = TLS1_3_VERSION, tString pem = "");
 
+    static void
+    EnableKtls(SSL_CTX *ctx);
+
     //PollableFD
     virtual EventHandlerForPollableFdPtr
     GetPollEventHandler() override
@@ -216,6 +264,9 @@ protected:
     virtual ssize_t
     writeFromCached();
 
+    virtual ssize_t
+    writeCoalesced(RawDataPtr rwData);
+
 private:
     SslNetworkConnection(SSL *ssl, sock_t fd);
     SslNetworkConnection(SSL *ssl, NetworkConnectionPtr netCon);
@@ -226,6 +277,21 @@ private:
     len_t
     handleFD();
 
+    void
+    scheduleFlush();
+
+    void
+    flushAtEndOfIteration();
+
+    common::PollControllerPtr
+    pollControllerIfAny();
+
+    void
+    offerCachedSession();
+
+    static int
+    newSessionCallback(SSL *ssl, SSL_SESSION *session);
+
     SSL_CTX *
     createCtxIfNotPresent(SSL_CTX *ctx);
 
@@ -250,6 +316,12 @@ private:
     pinggy::VoidPtr             asyncConnectPtr;
     int                         minTlsVersion;
     int                         maxTlsVersion;
+    bool                        writeCoalescing;
+    bool                        flushScheduled;
+    RawDataPtr                  stagedData;
+    bool                        sessionResumption;
+    tString                     sessionCacheKey;
+    std::vector<tString>        alpnProtocols;
 };
 
 DefineMakeSharedPtr(SslNetworkConnection);
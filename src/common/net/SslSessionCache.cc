@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SslSessionCache.hh"
+#include <ctime>
+
+namespace net
+{
+
+SslSessionCache::~SslSessionCache()
+{
+    for (auto &entry : sessions) {
+        for (auto session : entry.second)
+            SSL_SESSION_free(session);
+    }
+    sessions.clear();
+}
+
+std::shared_ptr<SslSessionCache>
+SslSessionCache::GetInstance()
+{
+    std::call_once(instanceFlag, [] {
+        instance = std::shared_ptr<SslSessionCache>(new SslSessionCache());
+    });
+    return instance;
+}
+
+void
+SslSessionCache::Store(tString key, SSL_SESSION *session)
+{
+    if (!session)
+        return;
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (sessions.find(key) == sessions.end() && sessions.size() >= SSL_SESSION_CACHE_MAX_KEYS) {
+        //No LRU here. It is a cache for reconnects to a handful of servers.
+        auto it = sessions.begin();
+        for (auto session : it->second)
+            SSL_SESSION_free(session);
+        sessions.erase(it);
+    }
+
+    auto &queue = sessions[key];
+    queue.push_back(session);
+    while (queue.size() > SSL_SESSION_CACHE_MAX_PER_KEY) {
+        SSL_SESSION_free(queue.front());
+        queue.pop_front();
+    }
+}
+
+SSL_SESSION *
+SslSessionCache::Take(tString key)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto it = sessions.find(key);
+    if (it == sessions.end())
+        return NULL;
+
+    SSL_SESSION *found = NULL;
+    auto &queue = it->second;
+    while (!queue.empty() && !found) {
+        auto session = queue.back(); //newest first
+        queue.pop_back();
+        if (isUsable(session))
+            found = session;
+        else
+            SSL_SESSION_free(session);
+    }
+
+    if (queue.empty())
+        sessions.erase(it);
+
+    return found;
+}
+
+void
+SslSessionCache::Remove(tString key)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto it = sessions.find(key);
+    if (it == sessions.end())
+        return;
+    for (auto session : it->second)
+        SSL_SESSION_free(session);
+    sessions.erase(it);
+}
+
+bool
+SslSessionCache::isUsable(SSL_SESSION *session)
+{
+    if (!SSL_SESSION_is_resumable(session))
+        return false;
+    auto expiry = SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session);
+    return expiry > (long)time(NULL);
+}
+
+std::shared_ptr<SslSessionCache> SslSessionCache::instance = nullptr;
+std::once_flag SslSessionCache::instanceFlag;
+
+} // namespace net
+
+INCLUDE_MEMORY_DUMP_DEFINITION
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SRC_COMMON_NET_SSLSESSIONCACHE_HH__
+#define __SRC_COMMON_NET_SSLSESSIONCACHE_HH__
+
+#include <platform/platform.h>
+#include <platform/SharedPtr.hh>
+#include <openssl/ssl.h>
+#include <map>
+#include <deque>
+#include <mutex>
+
+namespace net
+{
+
+#define SSL_SESSION_CACHE_MAX_KEYS          256
+#define SSL_SESSION_CACHE_MAX_PER_KEY       4
+
+/*
+ * Process wide store of client side TLS sessions (tickets), keyed by server
+ * address and sni. Reconnecting connections take one out and offer it to the
+ * server to skip the full handshake. It can be used from any thread.
+ */
+class SslSessionCache: virtual public pinggy::SharedObject
+{
+public:
+    SslSessionCache(const SslSessionCache&) = delete;
+    SslSessionCache& operator=(const SslSessionCache&) = delete;
+
+    virtual
+    ~SslSessionCache();
+
+    static std::shared_ptr<SslSessionCache>
+    GetInstance();
+
+    // Takes over the reference held by the caller.
+    void
+    Store(tString key, SSL_SESSION *session);
+
+    // Returns a resumable session or NULL. The caller owns the reference.
+    // TLS1.3 tickets are meant for single use, so it gets removed from the cache.
+    SSL_SESSION *
+    Take(tString key);
+
+    void
+    Remove(tString key);
+
+    DefineMandatoryClassFunctionsWOSuper(SslSessionCache);
+
+private:
+    SslSessionCache()           { }
+
+    static bool
+    isUsable(SSL_SESSION *session);
+
+    std::mutex                  lock;
+    std::map<tString, std::deque<SSL_SESSION *>>
+                                sessions;
+
+    static std::shared_ptr<SslSessionCache>
+                                instance;
+    static std::once_flag       instanceFlag;
+};
+DefineMakeSharedPtr(SslSessionCache);
+
+} // namespace net
+
+#endif // __SRC_COMMON_NET_SSLSESSIONCACHE_HH__
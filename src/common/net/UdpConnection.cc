@@ -16,6 +16,8 @@
 
 #include "UdpConnection.hh"
 #include <openssl/ssl.h>
+#include <string.h>
+#include <algorithm>
 
 
 namespace net
@@ -33,7 +35,10 @@ UdpConnectionImpl::UdpConnectionImpl(tString host, tString port):
         flags(0),
         lastReturn(0),
         blocking(false),
-        tryAgain(false)
+        tryAgain(false),
+        gso(false),
+        gro(false),
+        gsoSegmentLimit(UDP_MAX_DATAGRAM_LEN)
 {
     sockaddr_ip peerAddr;
     auto sock = app_udp_client_connect_host(host.c_str(), port.c_str(), &peerAddr);
@@ -42,6 +47,9 @@ UdpConnectionImpl::UdpConnectionImpl(tString host, tString port):
     }
     fd = sock;
     peerAddress = NewSocketAddressPtr(peerAddr);
+    gso = app_udp_gso_supported(fd) == 1;
+    gro = app_udp_enable_gro(fd) == 1;
+    LOGD("udp segmentation offload for fd:", fd, "gso:", gso, "gro:", gro);
 
     netState.Udp = true;
     netState.Valid = IsValidSocket(fd);
@@ -53,39 +61,32 @@ UdpConnectionImpl::__Init()
     pollEventObject = NewEventHandlerForPollableFdPtr(thisPtr);
 }
 
+static inline uint16_t
+framedLength(const char *frame)
+{
+    uint16_t len;
+    memcpy(&len, frame, sizeof(len));
+    return app_ntohs(len);
+}
+
 //========================
 std::tuple<ssize_t, RawDataPtr>
 UdpConnectionImpl::Read(len_t nbyte, int flags)
 {
     if (!rxData || !rxData->Len) {
-        rxData = NewRawDataPtr(2048);
-        sockaddr_ip addr;
-        socklen_t addrLen = sizeof(addr);
-        auto rxLen = app_recv_from(fd, rxData->Data+2, rxData->Capa-2, 0, &addr, &addrLen);
-        tryAgain = false;
-
-        if (rxLen < 0 && app_is_eagain()) {
-            tryAgain = true;
-            rxData = nullptr;
-            return {-1, nullptr};
-        }
-        if (rxLen <= 0) {
-            rxData = nullptr;
-            return {rxLen, nullptr};
-        }
-        if (rxLen >= (rxData->Capa-2)) {
-            rxData = nullptr;
-            tryAgain = true;
-            return {-1, nullptr};
-        }
-        *((uint16_t *)(rxData->Data)) = (uint16_t) app_htons(rxLen);
-        rxData->Len = rxLen+2;
+        rxData = nullptr;
+        auto ret = receiveBatch();
+        if (ret <= 0)
+            return {ret, nullptr};
     }
 
     auto ret = rxData->Slice(0, nbyte);
     rxData->Consume(nbyte);
     if (rxData->Len == 0) {
         rxData = nullptr;
+    } else {
+        //The rest of the batch is not in the socket anymore, make sure we get called again
+        RaiseDummyReadPoll();
     }
     return {ret->Len, ret};
 }
@@ -93,43 +94,187 @@ UdpConnectionImpl::Read(len_t nbyte, int flags)
 ssize_t
 UdpConnectionImpl::Write(RawDataPtr rwData, int flags)
 {
-    uint16_t expectedLen = 0;
-    if (!txData) {
-        txData = NewRawDataPtr(2048);
-        expectedLen = 2;
-    } else {
+    auto data = rwData->GetData();
+    RawData::tLen avail = rwData->Len;
+    RawData::tLen consumed = 0;
+    tryAgain = false;
+
+    if (txData) { //a datagram split over several writes
         if (txData->Len < 2) {
-            expectedLen = 2 - txData->Len;
-        } else {
-            expectedLen = app_ntohs(*((uint16_t *)(txData->Data))) + 2;
-            expectedLen -= txData->Len;
+            auto take = std::min(2 - txData->Len, avail);
+            txData->AddData(data, take);
+            consumed += take;
+            if (txData->Len < 2)
+                return consumed;
+            auto frame = NewRawDataPtr(framedLength(txData->GetData()) + 2);
+            frame->AddData(txData->GetData(), 2);
+            txData = frame;
+        }
+        RawData::tLen expected = framedLength(txData->GetData()) + 2;
+        auto take = std::min(expected - txData->Len, avail - consumed);
+        txData->AddData(data + consumed, take);
+        consumed += take;
+        if (txData->Len < expected)
+            return consumed;
+
+        auto frame = txData;
+        txData = nullptr;
+        app_datagram datagram = {frame->GetData() + 2, (size_t)(expected - 2), 0, 0};
+        if (sendBatch(&datagram, 1) < 0)
+            return -1;
+    }
+
+    //Complete datagrams are sent straight from rwData
+    app_datagram datagrams[UDP_DATAGRAM_BATCH];
+    int count = 0;
+    while (avail - consumed >= 2) {
+        RawData::tLen len = framedLength(data + consumed);
+        if (avail - consumed < len + 2)
+            break;
+        datagrams[count++] = app_datagram{data + consumed + 2, (size_t)len, 0, 0};
+        consumed += len + 2;
+        if (count == UDP_DATAGRAM_BATCH) {
+            if (sendBatch(datagrams, count) < 0)
+                return -1;
+            count = 0;
         }
     }
+    if (count && sendBatch(datagrams, count) < 0)
+        return -1;
+
+    if (consumed < avail) { //keep the partial datagram until the rest arrives
+        auto rest = avail - consumed;
+        txData = NewRawDataPtr(rest >= 2 ? framedLength(data + consumed) + 2 : 2);
+        txData->AddData(data + consumed, rest);
+        consumed = avail;
+    }
+    return consumed;
+}
+
+ssize_t
+UdpConnectionImpl::receiveBatch()
+{
+    int slots = gro ? UDP_GRO_BATCH : UDP_DATAGRAM_BATCH;
+    size_t slotLen = gro ? UDP_GRO_BUFFER_LEN : UDP_MAX_DATAGRAM_LEN;
+    if (!rxRing)
+        rxRing = NewRawDataPtr(slots * slotLen);
 
-    auto slice = rwData->Slice(0, expectedLen);
-    txData->Concat(slice);
+    app_datagram datagrams[UDP_DATAGRAM_BATCH];
+    for (int i = 0; i < slots; i++)
+        datagrams[i] = app_datagram{rxRing->Data + i * slotLen, slotLen, 0, 0};
 
-    if (txData->Len <= 2) {
-        return slice->Len;
+    auto count = app_recv_datagrams(fd, datagrams, slots, 0);
+    tryAgain = false;
+    if (count < 0 && app_is_eagain()) {
+        tryAgain = true;
+        return -1;
     }
+    if (count <= 0)
+        return count;
 
-    expectedLen = app_ntohs(*((uint16_t *)(txData->Data))) + 2;
-    Assert(expectedLen >= txData->Len);
-    if (expectedLen == txData->Len) {
-        sockaddr_ip addr = peerAddress->GetSockAddr();
-        socklen_t addrlen = addr.addr.sa_family==AF_INET ? sizeof(addr.inaddr) : sizeof(addr.inaddr);
-        tryAgain = false;
-        auto wrote = app_send_to(fd, txData->GetData()+2, txData->Len-2, 0, &addr, addrlen);
-        txData = nullptr;
-        if (wrote <= -1  && app_is_eagain()) {
-            return slice->Len;
+    //A coalesced buffer holds datagrams of `segment` bytes, the last one may
+    // be shorter. Each of them gets its own length prefix.
+    RawData::tLen total = 0;
+    for (int i = 0; i < count; i++) {
+        auto segment = datagrams[i].segment ? datagrams[i].segment : datagrams[i].len;
+        if (datagrams[i].truncated || segment > UDP_MAX_DATAGRAM_LEN)
+            continue;
+        auto pieces = segment ? (datagrams[i].len + segment - 1) / segment : 1;
+        total += datagrams[i].len + 2 * pieces;
+    }
+    if (total == 0) { //only oversized datagrams, they are dropped
+        tryAgain = true;
+        return -1;
+    }
+
+    rxData = NewRawDataPtr(total);
+    for (int i = 0; i < count; i++) {
+        auto segment = datagrams[i].segment ? datagrams[i].segment : datagrams[i].len;
+        if (datagrams[i].truncated || segment > UDP_MAX_DATAGRAM_LEN) {
+            LOGD("Dropping oversized datagram");
+            continue;
+        }
+        auto buf = (char *)datagrams[i].buf;
+        size_t offset = 0;
+        do {
+            auto len = std::min(segment, datagrams[i].len - offset);
+            rxData->AddData((uint16_t)app_htons(len));
+            rxData->AddData(buf + offset, len);
+            offset += len;
+        } while (offset < datagrams[i].len);
+    }
+    return rxData->Len;
+}
+
+//Number of datagrams from the start of the list that can go out as one
+// segmented send: equal lengths, optionally followed by one shorter datagram.
+// UDP_DATAGRAM_BATCH * UDP_MAX_DATAGRAM_LEN stays below the 64KB limit of a
+// segmented send, so the run length needs no other bound.
+int
+UdpConnectionImpl::segmentRun(app_datagram *datagrams, int count)
+{
+    auto segment = datagrams[0].len;
+    if (!gso || segment == 0 || segment > gsoSegmentLimit)
+        return 1;
+
+    int run = 1;
+    while (run < count && datagrams[run].len == segment)
+        run++;
+    if (run < count && datagrams[run].len > 0 && datagrams[run].len < segment)
+        run++;
+    return run;
+}
+
+void
+UdpConnectionImpl::segmentedSendFailed(size_t segment)
+{
+    //EINVAL: segments larger than the path mtu. Anything else (EIO without
+    // checksum offload, ENOTSUP) rules out segmentation on this socket.
+    if (app_get_errno() == EINVAL && segment > 1) {
+        gsoSegmentLimit = std::min(gsoSegmentLimit, segment - 1);
+        LOGD("Segmented send of", segment, "bytes rejected, limit now", gsoSegmentLimit);
+    } else {
+        gso = false;
+        LOGD("Disabling segmented send:", app_get_strerror(app_get_errno()));
+    }
+}
+
+ssize_t
+UdpConnectionImpl::sendBatch(app_datagram *datagrams, int count)
+{
+    sockaddr_ip addr = peerAddress->GetSockAddr();
+    socklen_t addrlen = addr.addr.sa_family == AF_INET ? sizeof(addr.inaddr) : sizeof(addr.in6addr);
+
+    int sent = 0;
+    while (sent < count) {
+        //Datagrams that cannot be segmented go out with one sendmmsg, up to
+        // the next run that can.
+        int plain = 0, run = 0;
+        while (sent + plain < count && (run = segmentRun(datagrams + sent + plain, count - sent - plain)) < 2)
+            plain++;
+
+        int ret;
+        if (plain) {
+            ret = app_send_datagrams(fd, datagrams + sent, plain, 0, &addr, addrlen);
+        } else {
+            ret = app_send_segments(fd, datagrams + sent, run, 0, &addr, addrlen);
+            if (ret < 0 && !app_is_eagain()) {
+                segmentedSendFailed(datagrams[sent].len);
+                continue; //the same datagrams go out the plain way
+            }
+        }
+
+        if (ret < 0 && app_is_eagain()) {
+            LOGD("Socket buffer full, dropping", count - sent, "datagrams");
+            return sent;
         }
-        if (wrote <= 0) {
+        if (ret <= 0) {
             LOGE("Socket error: ", app_get_strerror(app_get_errno()));
-            return wrote;
+            return -1;
         }
+        sent += ret;
     }
-    return slice->Len;
+    return sent;
 }
 
 std::tuple<ssize_t, RawDataPtr>
@@ -19,6 +19,16 @@
 
 #include "NetworkConnection.hh"
 
+//Datagrams moved per syscall, and the largest datagram we forward. The
+// stream side carries every datagram with a 2 byte length prefix.
+#define UDP_DATAGRAM_BATCH      16
+#define UDP_MAX_DATAGRAM_LEN    2046
+
+//With GRO one receive can return up to 64KB of coalesced datagrams, so the
+// receive ring switches to fewer, larger slots.
+#define UDP_GRO_BATCH           4
+#define UDP_GRO_BUFFER_LEN      65535
+
 namespace net
 {
 
@@ -111,6 +121,10 @@ public:
     virtual bool
     EnableKeepAlive(int keepCnt, int keepIdleSec, int keepIntvl, bool enable = true) override;
 
+    virtual bool
+    ApplySocketTuning(const SocketTuning &tuning) override
+                                { return false; }
+
     virtual bool
     ReassigntoLowerFd() override
                                 { return ReassigntoLowerFdPtr(&fd); }
@@ -149,6 +163,18 @@ protected:
                                 { pollEventObject = nullptr; }
 
 private:
+    ssize_t
+    receiveBatch();
+
+    ssize_t
+    sendBatch(app_datagram *datagrams, int count);
+
+    int
+    segmentRun(app_datagram *datagrams, int count);
+
+    void
+    segmentedSendFailed(size_t segment);
+
     sock_t                      fd;
     SocketAddressPtr            peerAddress;
     SocketAddressPtr            localAddress;
@@ -156,9 +182,13 @@ private:
     ssize_t                     lastReturn;
     bool                        blocking;
     bool                        tryAgain;
+    bool                        gso;
+    bool                        gro;
+    size_t                      gsoSegmentLimit; //largest segment the path accepted
 
     RawDataPtr                  rxData;
     RawDataPtr                  txData;
+    RawDataPtr                  rxRing; //reused receive buffers
     tNetState                   netState;
     EventHandlerForPollableFdPtr
                                 pollEventObject;
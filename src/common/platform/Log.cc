@@ -23,7 +23,13 @@
 #include <fstream>
 #include <stdarg.h>
 #include "Log.hh"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 
 
@@ -34,10 +40,251 @@ std::string                     __PINGGY_LOG_PREFIX__ = "";
 pid_t                           __PINGGY_LOG_PID__ = 0;
 // int64_t                         __LastChrono = 0;
 bool                            __PINGGY_GLOBAL_ENABLED__ = true;
+std::atomic<int>                __PINGGY_LOG_LEVELS__[LogModuleCount] = {
+                                    {RUNTIME_LOG_LEVEL}, {RUNTIME_LOG_LEVEL}, {RUNTIME_LOG_LEVEL},
+                                    {RUNTIME_LOG_LEVEL}, {RUNTIME_LOG_LEVEL}, {RUNTIME_LOG_LEVEL},
+                                };
 
 //Local
 std::string                     __logPath = "";
 
+//Held while writing to the sink or replacing it.
+static std::mutex               __sinkLock;
+
+/*
+ * Single producer single consumer ring of log lines. The owning thread
+ * pushes, the writer thread (or FlushLog) pops. Each line is stored as a
+ * 4 byte length followed by its bytes and may wrap around the end.
+ */
+class LogRing
+{
+public:
+    LogRing(size_t capacity): orphaned(false), pushing(false), buffer(capacity), mask(capacity - 1), head(0), tail(0)
+                                { }
+
+    bool
+    Push(const char *data, uint32_t len)
+    {
+        size_t need = sizeof(len) + len;
+        auto t = tail.load(std::memory_order_relaxed);
+        auto h = head.load(std::memory_order_acquire);
+        if (buffer.size() - (t - h) < need)
+            return false;
+        copyIn(t, &len, sizeof(len));
+        copyIn(t + sizeof(len), data, len);
+        tail.store(t + need, std::memory_order_release);
+        return true;
+    }
+
+    void
+    PopAll(std::string &out)
+    {
+        auto t = tail.load(std::memory_order_acquire);
+        auto h = head.load(std::memory_order_relaxed);
+        while (h < t) {
+            uint32_t len;
+            copyOut(h, &len, sizeof(len));
+            auto offset = out.size();
+            out.resize(offset + len);
+            copyOut(h + sizeof(len), &out[offset], len);
+            h += sizeof(len) + len;
+        }
+        head.store(h, std::memory_order_release);
+    }
+
+    size_t
+    Used()                      { return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_relaxed); }
+
+    size_t
+    Capacity()                  { return buffer.size(); }
+
+    bool
+    IsEmpty()                   { return tail.load(std::memory_order_acquire) == head.load(std::memory_order_relaxed); }
+
+    std::atomic<bool>           orphaned; //owning thread is gone
+    std::atomic<bool>           pushing; //owning thread decided to push, see EnableAsyncLog
+
+private:
+    void
+    copyIn(size_t pos, const void *data, size_t len)
+    {
+        auto idx = pos & mask;
+        auto first = std::min(len, buffer.size() - idx);
+        memcpy(&buffer[idx], data, first);
+        memcpy(&buffer[0], (const char *)data + first, len - first);
+    }
+
+    void
+    copyOut(size_t pos, void *data, size_t len)
+    {
+        auto idx = pos & mask;
+        auto first = std::min(len, buffer.size() - idx);
+        memcpy(data, &buffer[idx], first);
+        memcpy((char *)data + first, &buffer[0], len - first);
+    }
+
+    std::vector<char>           buffer;
+    size_t                      mask;
+    std::atomic<size_t>         head; //consumer position
+    std::atomic<size_t>         tail; //producer position
+};
+
+//Keeps the formatted line in a string that is reused for the next line.
+class LogLineBuffer: public std::streambuf
+{
+public:
+    void
+    Reset()                     { line.clear(); }
+
+    std::string                 line;
+
+protected:
+    virtual int_type
+    overflow(int_type ch) override
+    {
+        if (ch != traits_type::eof())
+            line.push_back((char)ch);
+        return ch;
+    }
+
+    virtual std::streamsize
+    xsputn(const char *data, std::streamsize len) override
+    {
+        line.append(data, len);
+        return len;
+    }
+};
+
+struct LogThreadState
+{
+    LogThreadState(): stream(&lineBuffer)
+                                { }
+
+    ~LogThreadState()           { if (ring) ring->orphaned = true; }
+
+    LogLineBuffer               lineBuffer;
+    std::ostream                stream;
+    std::shared_ptr<LogRing>    ring;
+};
+
+static thread_local LogThreadState
+                                __logThreadState;
+
+static std::atomic<bool>        __asyncLogEnabled(false);
+static std::atomic<size_t>      __asyncLogRingSize(ASYNC_LOG_RING_SIZE);
+static std::atomic<uint64_t>    __asyncLogDropped(0);
+static std::mutex               __asyncLogControlLock; //enable / disable
+static std::mutex               __asyncLogRingsLock;
+static std::vector<std::shared_ptr<LogRing>>
+                                __asyncLogRings;
+static std::mutex               __asyncLogDrainLock; //keeps the rings single consumer
+static std::mutex               __asyncLogWakeLock;
+static std::condition_variable  __asyncLogWake;
+static bool                     __asyncLogStop = false;
+static std::thread              __asyncLogWriter;
+
+#define ASYNC_LOG_WRITE_INTERVAL std::chrono::milliseconds(20)
+
+static void
+writeToSink(const std::string &data)
+{
+    std::lock_guard<std::mutex> lock(__sinkLock);
+    __PINGGY_LOGGER_OSTREAM_SINK__->write(data.data(), data.size());
+    __PINGGY_LOGGER_OSTREAM_SINK__->flush();
+}
+
+static void
+drainLogRings()
+{
+    std::lock_guard<std::mutex> drainLock(__asyncLogDrainLock);
+
+    std::vector<std::shared_ptr<LogRing>> rings;
+    {
+        std::lock_guard<std::mutex> lock(__asyncLogRingsLock);
+        rings = __asyncLogRings;
+    }
+
+    std::string batch;
+    for (auto &ring : rings)
+        ring->PopAll(batch);
+    if (!batch.empty())
+        writeToSink(batch);
+
+    std::lock_guard<std::mutex> lock(__asyncLogRingsLock);
+    __asyncLogRings.erase(std::remove_if(__asyncLogRings.begin(), __asyncLogRings.end(),
+                            [](const std::shared_ptr<LogRing> &ring) { return ring->orphaned && ring->IsEmpty(); }),
+                          __asyncLogRings.end());
+}
+
+static void
+asyncLogWriterLoop()
+{
+    while (true) {
+        bool stop;
+        {
+            std::unique_lock<std::mutex> lock(__asyncLogWakeLock);
+            __asyncLogWake.wait_for(lock, ASYNC_LOG_WRITE_INTERVAL, []{ return __asyncLogStop; });
+            stop = __asyncLogStop;
+        }
+        drainLogRings();
+        if (stop)
+            break;
+    }
+}
+
+//Stops the writer when the process exits normally, so nothing is lost.
+static struct AsyncLogShutdown
+{
+    ~AsyncLogShutdown()         { EnableAsyncLog(false); }
+} __asyncLogShutdown;
+
+std::ostream &
+__PinggyLogStream()
+{
+    __logThreadState.lineBuffer.Reset();
+    return __logThreadState.stream;
+}
+
+static std::shared_ptr<LogRing> &
+threadLogRing()
+{
+    auto &ring = __logThreadState.ring;
+    if (!ring) {
+        size_t capacity = 1;
+        while (capacity < __asyncLogRingSize.load(std::memory_order_relaxed))
+            capacity <<= 1;
+        ring = std::make_shared<LogRing>(capacity);
+        std::lock_guard<std::mutex> lock(__asyncLogRingsLock);
+        __asyncLogRings.push_back(ring);
+    }
+    return ring;
+}
+
+void
+__PinggyLogCommit()
+{
+    auto &line = __logThreadState.lineBuffer.line;
+
+    if (__asyncLogEnabled.load(std::memory_order_relaxed)) {
+        auto &ring = threadLogRing();
+
+        //Announce the push before checking again, EnableAsyncLog(false)
+        // waits for announced pushes before the last drain.
+        ring->pushing.store(true, std::memory_order_seq_cst);
+        if (__asyncLogEnabled.load(std::memory_order_seq_cst)) {
+            if (!ring->Push(line.data(), (uint32_t)line.size()))
+                __asyncLogDropped.fetch_add(1, std::memory_order_relaxed);
+            ring->pushing.store(false, std::memory_order_release);
+            if (ring->Used() > ring->Capacity() / 2)
+                __asyncLogWake.notify_one(); //do not wait for the next round
+            return;
+        }
+        ring->pushing.store(false, std::memory_order_relaxed);
+    }
+
+    writeToSink(line);
+}
+
 tString
 GetLogPrefix()
 {
@@ -54,6 +301,7 @@ SetLogPrefix(std::string pref)
 void
 InitLogWithOstream(std::ostream &os)
 {
+    std::lock_guard<std::mutex> lock(__sinkLock);
     __PINGGY_LOG_PID__ = app_getpid();
     __logPath = "";
     __PINGGY_LOGGER_OSTREAM_SINK__ = &os;
@@ -73,6 +321,7 @@ InitLog(std::string path)
 
     if (!f->is_open())
         return;
+    std::lock_guard<std::mutex> lock(__sinkLock);
     __PINGGY_LOGGER_OSTREAM_SINK__ = f.get();
     __PINGGY_LOGGER_OFS_SINK__ = std::move(f);
     __logPath = path;
@@ -91,15 +340,95 @@ UpdatePidForLog()
     __PINGGY_LOG_PID__ = app_getpid();
 }
 
+void
+EnableAsyncLog(bool enable, size_t ringSize)
+{
+    std::lock_guard<std::mutex> lock(__asyncLogControlLock);
+
+    if (enable) {
+        __asyncLogRingSize = std::max(ringSize, (size_t)1024);
+        if (__asyncLogWriter.joinable())
+            return;
+        __asyncLogStop = false;
+        __asyncLogWriter = std::thread(asyncLogWriterLoop);
+        __asyncLogEnabled = true;
+        return;
+    }
+
+    if (!__asyncLogWriter.joinable())
+        return;
+
+    __asyncLogEnabled.store(false, std::memory_order_seq_cst);
+    {
+        std::lock_guard<std::mutex> wakeLock(__asyncLogWakeLock);
+        __asyncLogStop = true;
+    }
+    __asyncLogWake.notify_one();
+    __asyncLogWriter.join();
+
+    //A thread that saw the async log enabled may still be pushing. Rings
+    // created from now on see it disabled and write directly.
+    std::vector<std::shared_ptr<LogRing>> rings;
+    {
+        std::lock_guard<std::mutex> ringsLock(__asyncLogRingsLock);
+        rings = __asyncLogRings;
+    }
+    for (auto &ring : rings) {
+        while (ring->pushing.load(std::memory_order_seq_cst))
+            std::this_thread::yield();
+    }
+    drainLogRings(); //lines pushed while it was stopping
+}
+
+bool
+IsAsyncLogEnabled()
+{
+    return __asyncLogEnabled.load(std::memory_order_relaxed);
+}
+
+void
+SetLogLevel(int module, int level)
+{
+    if (module < 0) {
+        for (auto &moduleLevel : __PINGGY_LOG_LEVELS__)
+            moduleLevel.store(level, std::memory_order_relaxed);
+        return;
+    }
+    if (module < LogModuleCount)
+        __PINGGY_LOG_LEVELS__[module].store(level, std::memory_order_relaxed);
+}
+
+int
+GetLogLevel(int module)
+{
+    if (module < 0 || module >= LogModuleCount)
+        return LogLevelDisable;
+    return __PINGGY_LOG_LEVELS__[module].load(std::memory_order_relaxed);
+}
+
+uint64_t
+GetDroppedLogCount()
+{
+    return __asyncLogDropped.load(std::memory_order_relaxed);
+}
+
+void
+FlushLog()
+{
+    drainLogRings();
+}
+
 
 extern "C" {
-char                            __LOG_BUF_[4096]; //4KB This should be good enough
-                                                  //also this is not thread safe
+thread_local char               __LOG_BUF_[4096]; //4KB This should be good enough
 void
 c_log(char *fl, int type, const char *fmt, ...)
 {
     va_list args;
 
+    if (__PINGGY_LOG_LEVELS__[LogModuleDefault].load(std::memory_order_relaxed) > type)
+        return;
+
     // Get the number of characters needed for the formatted string
     va_start(args, fmt);
     vsnprintf(__LOG_BUF_, sizeof(__LOG_BUF_), fmt, args);
@@ -25,6 +25,8 @@
 #include <chrono>
 #include <iostream>
 #include <sstream>
+#include <atomic>
+#include <type_traits>
 #endif //__cplusplus
 
 #include <stdlib.h>
@@ -47,6 +49,22 @@
 #define LOG_LEVEL LogLevelTrace
 #endif
 
+//Level every module starts with. Lines below LOG_LEVEL are compiled out and
+// cannot be enabled at runtime.
+#ifndef RUNTIME_LOG_LEVEL
+#define RUNTIME_LOG_LEVEL LOG_LEVEL
+#endif
+
+//Modules with a runtime log level of their own. The module of a log line is
+// the directory of the file it is written in.
+#define LogModuleDefault 0
+#define LogModulePoll 1
+#define LogModuleNet 2
+#define LogModuleTransport 3
+#define LogModuleProtocol 4
+#define LogModuleSdk 5
+#define LogModuleCount 6
+
 
 #define APP_CONVERT_TO_STRING_(x) #x
 #define APP_CONVERT_TO_STRING(x) APP_CONVERT_TO_STRING_(x)
@@ -56,27 +74,75 @@
 #ifdef __cplusplus
 
 extern std::ostream            *__PINGGY_LOGGER_OSTREAM_SINK__;
-#define __PINGGY_LOGGER_SINK__  (*__PINGGY_LOGGER_OSTREAM_SINK__)
+#define __PINGGY_LOGGER_SINK__  (__PinggyLogStream())
 extern std::string              __PINGGY_LOG_PREFIX__;
 extern pid_t                    __PINGGY_LOG_PID__;
 extern bool                     __PINGGY_GLOBAL_ENABLED__;
+extern std::atomic<int>         __PINGGY_LOG_LEVELS__[LogModuleCount];
+
+//Whether the directory holding the file is named dir.
+constexpr bool
+__PinggyLogParentIs(const char *path, const char *dir)
+{
+    const char *last = nullptr, *prev = nullptr;
+    for (const char *p = path; *p; p++) {
+        if (*p == '/' || *p == '\\') {
+            prev = last;
+            last = p;
+        }
+    }
+    if (!last)
+        return false;
+    const char *name = prev ? prev + 1 : path;
+    while (name < last && *dir && *name == *dir) {
+        name++;
+        dir++;
+    }
+    return name == last && !*dir;
+}
+
+constexpr std::size_t
+__PinggyLogModuleOf(const char *path)
+{
+    return __PinggyLogParentIs(path, "poll")          ? LogModulePoll
+         : __PinggyLogParentIs(path, "net")           ? LogModuleNet
+         : __PinggyLogParentIs(path, "transport")     ? LogModuleTransport
+         : __PinggyLogParentIs(path, "protocol")      ? LogModuleProtocol
+         : __PinggyLogParentIs(path, "sdk")           ? LogModuleSdk
+         : LogModuleDefault;
+}
+
+//The module is resolved while compiling, at runtime it is one relaxed load
+// and nothing of the log line is evaluated if the level is off.
+#define __LOG_ENABLED(lvl__) \
+    (__PINGGY_LOG_LEVELS__[std::integral_constant<std::size_t, __PinggyLogModuleOf(__FILE__)>::value].load(std::memory_order_relaxed) <= (lvl__))
+
+//A log line is formatted into a stream local to the thread and then handed
+// over as a whole, either to the async writer or straight to the sink.
+std::ostream &
+__PinggyLogStream();
+
+void
+__PinggyLogCommit();
 
 
 #define __LTIME \
     (std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count())
 
-#define __LOG(x__, __y) do{ \
-    if (__PINGGY_GLOBAL_ENABLED__) { \
+#define __LOG(lvl__, x__, __y) do{ \
+    if (__LOG_ENABLED(lvl__) && __PINGGY_GLOBAL_ENABLED__) { \
         auto ttime = __LTIME; \
         x__ << ttime << ":: " __FILE__ ":" \
-            APP_CONVERT_TO_STRING(__LINE__) << " " << __PINGGY_LOG_PREFIX__ << "(" << __PINGGY_LOG_PID__ << ")::" __y std::endl; \
+            APP_CONVERT_TO_STRING(__LINE__) << " " << __PINGGY_LOG_PREFIX__ << "(" << __PINGGY_LOG_PID__ << ")::" __y "\n"; \
+        __PinggyLogCommit(); \
     } \
 }while(0)
 
 #define __LOG_FL(FL__, x__, __y) do{ \
     if (__PINGGY_GLOBAL_ENABLED__) { \
         auto ttime = __LTIME; \
-        x__ << ttime << ":: " << FL__ << " " << __PINGGY_LOG_PREFIX__ << "(" << __PINGGY_LOG_PID__ << ")::" __y std::endl; \
+        x__ << ttime << ":: " << FL__ << " " << __PINGGY_LOG_PREFIX__ << "(" << __PINGGY_LOG_PID__ << ")::" __y "\n"; \
+        __PinggyLogCommit(); \
     } \
 } while(0)
 
@@ -95,31 +161,31 @@ extern bool                     __PINGGY_GLOBAL_ENABLED__;
 
 
 #if LOG_LEVEL <= LogLevelTrace
-    #define LOGT(...) __LOG(__PINGGY_LOGGER_SINK__,  "TRACE:: " __EXPAND_LOGS__(__VA_ARGS__))
+    #define LOGT(...) __LOG(LogLevelTrace, __PINGGY_LOGGER_SINK__,  "TRACE:: " __EXPAND_LOGS__(__VA_ARGS__))
 #else
     #define LOGT(...)
 #endif
 
 #if LOG_LEVEL <= LogLevelDebug
-    #define LOGD(...) __LOG(__PINGGY_LOGGER_SINK__,  "DEBUG:: " __EXPAND_LOGS__(__VA_ARGS__))
+    #define LOGD(...) __LOG(LogLevelDebug, __PINGGY_LOGGER_SINK__,  "DEBUG:: " __EXPAND_LOGS__(__VA_ARGS__))
 #else
     #define LOGD(...)
 #endif
 
 #if LOG_LEVEL <= LogLevelInfo
-    #define LOGI(...) __LOG(__PINGGY_LOGGER_SINK__,  "INFO:: " __EXPAND_LOGS__(__VA_ARGS__))
+    #define LOGI(...) __LOG(LogLevelInfo, __PINGGY_LOGGER_SINK__,  "INFO:: " __EXPAND_LOGS__(__VA_ARGS__))
 #else
     #define LOGI(...)
 #endif
 
 #if LOG_LEVEL <= LogLevelError
-    #define LOGE(...) __LOG(__PINGGY_LOGGER_SINK__,  "ERROR:: " __EXPAND_LOGS__(__VA_ARGS__))
+    #define LOGE(...) __LOG(LogLevelError, __PINGGY_LOGGER_SINK__,  "ERROR:: " __EXPAND_LOGS__(__VA_ARGS__))
 #else
     #define LOGE(...)
 #endif
 
 #if LOG_LEVEL <= LogLevelFatal
-    #define LOGF(...) __LOG(__PINGGY_LOGGER_SINK__,  "FATAL:: " __EXPAND_LOGS__(__VA_ARGS__))
+    #define LOGF(...) __LOG(LogLevelFatal, __PINGGY_LOGGER_SINK__,  "FATAL:: " __EXPAND_LOGS__(__VA_ARGS__))
     #define LOGFC(FL, ...) __LOG_FL(FL, __PINGGY_LOGGER_SINK__,  "FATAL:: " __EXPAND_LOGS__(__VA_ARGS__))
 #else
     #define LOGF(...)
@@ -127,7 +193,7 @@ extern bool                     __PINGGY_GLOBAL_ENABLED__;
 #endif
 
 #if LOG_LEVEL <= LogLevelError
-    #define LOGA(...) __LOG(__PINGGY_LOGGER_SINK__,  "ANALYSIS:: " __EXPAND_LOGS__(__VA_ARGS__))
+    #define LOGA(...) __LOG(LogLevelError, __PINGGY_LOGGER_SINK__,  "ANALYSIS:: " __EXPAND_LOGS__(__VA_ARGS__))
 #else
     #define LOGA(...)
 #endif
@@ -135,7 +201,7 @@ extern bool                     __PINGGY_GLOBAL_ENABLED__;
 //====
 
 #if LOG_LEVEL <= LogLevelTrace
-    #define LOGTV(...) __LOG(__PINGGY_LOGGER_SINK__,  "TRACE:: " __EXPAND_LOG_VARS__(__VA_ARGS__))
+    #define LOGTV(...) __LOG(LogLevelTrace, __PINGGY_LOGGER_SINK__,  "TRACE:: " __EXPAND_LOG_VARS__(__VA_ARGS__))
     #define LOGSSLT(...) __LOGSSL(LogLevelTrace, __VA_ARGS__)
 #else
     #define LOGTV(...)
@@ -143,7 +209,7 @@ extern bool                     __PINGGY_GLOBAL_ENABLED__;
 #endif
 
 #if LOG_LEVEL <= LogLevelDebug
-    #define LOGDV(...) __LOG(__PINGGY_LOGGER_SINK__,  "DEBUG:: " __EXPAND_LOG_VARS__(__VA_ARGS__))
+    #define LOGDV(...) __LOG(LogLevelDebug, __PINGGY_LOGGER_SINK__,  "DEBUG:: " __EXPAND_LOG_VARS__(__VA_ARGS__))
     #define LOGSSLD(...) __LOGSSL(LogLevelDebug, __VA_ARGS__)
 #else
     #define LOGDV(...)
@@ -151,7 +217,7 @@ extern bool                     __PINGGY_GLOBAL_ENABLED__;
 #endif
 
 #if LOG_LEVEL <= LogLevelInfo
-    #define LOGIV(...) __LOG(__PINGGY_LOGGER_SINK__,  "INFO:: " __EXPAND_LOG_VARS__(__VA_ARGS__))
+    #define LOGIV(...) __LOG(LogLevelInfo, __PINGGY_LOGGER_SINK__,  "INFO:: " __EXPAND_LOG_VARS__(__VA_ARGS__))
     #define LOGSSLI(...) __LOGSSL(LogLevelInfo, __VA_ARGS__)
 #else
     #define LOGIV(...)
@@ -159,7 +225,7 @@ extern bool                     __PINGGY_GLOBAL_ENABLED__;
 #endif
 
 #if LOG_LEVEL <= LogLevelError
-    #define LOGEV(...) __LOG(__PINGGY_LOGGER_SINK__,  "ERROR:: " __EXPAND_LOG_VARS__(__VA_ARGS__))
+    #define LOGEV(...) __LOG(LogLevelError, __PINGGY_LOGGER_SINK__,  "ERROR:: " __EXPAND_LOG_VARS__(__VA_ARGS__))
     #define LOGSSLE(...) __LOGSSL(LogLevelError, __VA_ARGS__)
 #else
     #define LOGEV(...)
@@ -167,7 +233,7 @@ extern bool                     __PINGGY_GLOBAL_ENABLED__;
 #endif
 
 #if LOG_LEVEL <= LogLevelFatal
-    #define LOGFV(...) __LOG(__PINGGY_LOGGER_SINK__,  "FATAL:: " __EXPAND_LOG_VARS__(__VA_ARGS__))
+    #define LOGFV(...) __LOG(LogLevelFatal, __PINGGY_LOGGER_SINK__,  "FATAL:: " __EXPAND_LOG_VARS__(__VA_ARGS__))
     #define LOGSSLF(...) __LOGSSL(LogLevelFatal, __VA_ARGS__)
 #else
     #define LOGFV(...)
@@ -189,9 +255,9 @@ extern bool                     __PINGGY_GLOBAL_ENABLED__;
 //====
 
 #ifdef NDEBUG
-#define ABORT() exit(1)
+#define ABORT() do { FlushLog(); exit(1); } while(0)
 #else
-#define ABORT() abort()
+#define ABORT() do { FlushLog(); abort(); } while(0)
 #endif
 
 #define ABORT_WITH_MSG(...) \
@@ -244,6 +310,42 @@ UpdatePidForLog();
 void
 SetGlobalLogEnable(bool enable = true);
 
+/**
+ * @brief Lines of the module below the level are not logged.
+ * @param module one of LogModule*, or -1 for all of them.
+ * @param level one of LogLevel*.
+ */
+void
+SetLogLevel(int module, int level);
+
+int
+GetLogLevel(int module);
+
+//Default size of the ring of each logging thread in async mode.
+#define ASYNC_LOG_RING_SIZE (256*1024)
+
+/**
+ * @brief In async mode a logging thread only copies the formatted line into
+ *        a ring of its own, a background thread writes the rings to the sink
+ *        in batches. Formatting stays on the logging thread, only the write
+ *        (and its lock and flush) moves. A line that does not fit in the
+ *        ring is dropped and counted. Disabling writes out whatever is left.
+ * @param ringSize bytes per logging thread, rounded up to a power of two.
+ *        Applies to the threads that log for the first time afterwards.
+ */
+void
+EnableAsyncLog(bool enable = true, size_t ringSize = ASYNC_LOG_RING_SIZE);
+
+bool
+IsAsyncLogEnabled();
+
+uint64_t
+GetDroppedLogCount();
+
+//Writes out every line logged so far. Called before aborting.
+void
+FlushLog();
+
 #endif //cplusplus
 
 #endif /* SRC_CPP_COMMON_LOG_H_ */
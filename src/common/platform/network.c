@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE //recvmmsg, sendmmsg
+#endif
 #include "network.h"
 
 #include <sys/types.h>
@@ -22,6 +25,7 @@
 #include <netdb.h>
 #include <stddef.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #else
@@ -623,11 +627,11 @@ sock_t app_udp_client_connect_host(const char *host, const char *port, sockaddr_
     for(rp = res; rp != NULL; rp=rp->ai_next) {
         if (rp->ai_family == AF_INET6) {
             peer_family = AF_INET6;
-            sockAddr->addr = *(rp->ai_addr);
+            memcpy(sockAddr, rp->ai_addr, rp->ai_addrlen);
             found = 1;
         } else if (rp->ai_family == AF_INET) {
             peer_family = AF_INET;
-            sockAddr->addr = *(rp->ai_addr);
+            memcpy(sockAddr, rp->ai_addr, rp->ai_addrlen);
             found = 1;
             break; //we want ipv4 here because almost all ipv4 can connect to ipv6
         }
@@ -886,6 +890,159 @@ ssize_t app_recv_from(sock_t sock, void *buf, size_t len, int flags, sockaddr_ip
     return recvfrom(sock, buf, len, flags, (struct sockaddr *)addr, addrlen);
 }
 
+#define MAX_DATAGRAM_BATCH 64
+
+#if defined(__LINUX_OS__) && defined(UDP_SEGMENT) && defined(UDP_GRO)
+#define HAVE_UDP_SEGMENTATION 1
+#define UDP_GRO_CONTROL_LEN CMSG_SPACE(sizeof(int))
+#endif
+
+int app_recv_datagrams(sock_t sock, app_datagram *dgrams, int count, int flags)
+{
+    if (count > MAX_DATAGRAM_BATCH)
+        count = MAX_DATAGRAM_BATCH;
+#ifdef __LINUX_OS__
+    struct mmsghdr msgs[MAX_DATAGRAM_BATCH];
+    struct iovec iovs[MAX_DATAGRAM_BATCH];
+#ifdef HAVE_UDP_SEGMENTATION
+    char control[MAX_DATAGRAM_BATCH][UDP_GRO_CONTROL_LEN];
+#endif
+    memset(msgs, 0, sizeof(struct mmsghdr) * count);
+    for (int i = 0; i < count; i++) {
+        iovs[i].iov_base = dgrams[i].buf;
+        iovs[i].iov_len = dgrams[i].len;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+#ifdef HAVE_UDP_SEGMENTATION
+        msgs[i].msg_hdr.msg_control = control[i];
+        msgs[i].msg_hdr.msg_controllen = UDP_GRO_CONTROL_LEN;
+#endif
+    }
+    int ret = recvmmsg(sock, msgs, count, flags | MSG_WAITFORONE, NULL); //never wait for the rest of the batch
+    for (int i = 0; i < ret; i++) {
+        dgrams[i].truncated = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ? 1 : 0;
+        dgrams[i].len = msgs[i].msg_len;
+        dgrams[i].segment = 0;
+#ifdef HAVE_UDP_SEGMENTATION
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                int segment;
+                memcpy(&segment, CMSG_DATA(cmsg), sizeof(segment));
+                dgrams[i].segment = segment > 0 && (size_t)segment < dgrams[i].len ? segment : 0;
+            }
+        }
+#endif
+    }
+    return ret;
+#else
+#ifndef MSG_DONTWAIT
+    count = 1; //cannot peek for more without blocking
+#endif
+    int i;
+    for (i = 0; i < count; i++) {
+#ifdef MSG_DONTWAIT
+        int rflags = i > 0 ? flags | MSG_DONTWAIT : flags;
+#else
+        int rflags = flags;
+#endif
+        ssize_t ret = recvfrom(sock, dgrams[i].buf, dgrams[i].len, rflags, NULL, NULL);
+        if (ret < 0)
+            return i > 0 ? i : -1;
+        dgrams[i].truncated = (size_t)ret == dgrams[i].len;
+        dgrams[i].len = ret;
+        dgrams[i].segment = 0;
+    }
+    return i;
+#endif
+}
+
+int app_send_datagrams(sock_t sock, app_datagram *dgrams, int count, int flags, sockaddr_ip *addr, socklen_t addrlen)
+{
+    if (count > MAX_DATAGRAM_BATCH)
+        count = MAX_DATAGRAM_BATCH;
+#ifdef __LINUX_OS__
+    struct mmsghdr msgs[MAX_DATAGRAM_BATCH];
+    struct iovec iovs[MAX_DATAGRAM_BATCH];
+    memset(msgs, 0, sizeof(struct mmsghdr) * count);
+    for (int i = 0; i < count; i++) {
+        iovs[i].iov_base = dgrams[i].buf;
+        iovs[i].iov_len = dgrams[i].len;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = addr;
+        msgs[i].msg_hdr.msg_namelen = addrlen;
+    }
+    return sendmmsg(sock, msgs, count, flags);
+#else
+    int i;
+    for (i = 0; i < count; i++) {
+        ssize_t ret = sendto(sock, dgrams[i].buf, dgrams[i].len, flags, (struct sockaddr *)addr, addrlen);
+        if (ret < 0)
+            return i > 0 ? i : -1;
+    }
+    return i;
+#endif
+}
+
+int app_udp_gso_supported(sock_t sock)
+{
+#ifdef HAVE_UDP_SEGMENTATION
+    int segment = 0;
+    socklen_t len = sizeof(segment);
+    return getsockopt(sock, SOL_UDP, UDP_SEGMENT, &segment, &len) == 0 ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+int app_udp_enable_gro(sock_t sock)
+{
+#ifdef HAVE_UDP_SEGMENTATION
+    int enable = 1;
+    return setsockopt(sock, SOL_UDP, UDP_GRO, &enable, sizeof(enable)) == 0 ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+int app_send_segments(sock_t sock, app_datagram *dgrams, int count, int flags, sockaddr_ip *addr, socklen_t addrlen)
+{
+#ifdef HAVE_UDP_SEGMENTATION
+    if (count > MAX_DATAGRAM_BATCH)
+        count = MAX_DATAGRAM_BATCH;
+    struct iovec iovs[MAX_DATAGRAM_BATCH];
+    for (int i = 0; i < count; i++) {
+        iovs[i].iov_base = dgrams[i].buf;
+        iovs[i].iov_len = dgrams[i].len;
+    }
+
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = addr;
+    msg.msg_namelen = addrlen;
+    msg.msg_iov = iovs;
+    msg.msg_iovlen = count;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    uint16_t segment = dgrams[0].len;
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(segment));
+    memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+
+    //The kernel splits the payload at every `segment` bytes, so each
+    // datagram goes out exactly as it was given.
+    return sendmsg(sock, &msg, flags) < 0 ? -1 : count;
+#else
+    app_set_errno(ENOTSUP);
+    return -1;
+#endif
+}
+
 
 char *app_get_strerror(int err) {
 #ifdef __WINDOWS_OS__
@@ -968,6 +1125,49 @@ int get_socket_type(sock_t socket)
     return optval;
 }
 
+static int set_tuning_option(sock_t fd, int level, int option, int32_t value, const char *name)
+{
+    int optval = value;
+    if (app_setsockopt(fd, level, option, (void *)&optval, sizeof(optval)) < 0) {
+        LOGEF(fd, "setsockopt %s", name);
+        return 0;
+    }
+    return 1;
+}
+
+int apply_socket_tuning(sock_t fd, const socket_tuning *tuning)
+{
+    int success = 1;
+    if (tuning->nodelay >= 0)
+        success &= set_tuning_option(fd, IPPROTO_TCP, TCP_NODELAY, tuning->nodelay, "TCP_NODELAY");
+    if (tuning->sndbuf >= 0)
+        success &= set_tuning_option(fd, SOL_SOCKET, SO_SNDBUF, tuning->sndbuf, "SO_SNDBUF");
+    if (tuning->rcvbuf >= 0)
+        success &= set_tuning_option(fd, SOL_SOCKET, SO_RCVBUF, tuning->rcvbuf, "SO_RCVBUF");
+    if (tuning->notsent_lowat >= 0) {
+#ifdef TCP_NOTSENT_LOWAT
+        success &= set_tuning_option(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, tuning->notsent_lowat, "TCP_NOTSENT_LOWAT");
+#else
+        success = 0;
+#endif
+    }
+    if (tuning->quickack >= 0) {
+#ifdef TCP_QUICKACK
+        success &= set_tuning_option(fd, IPPROTO_TCP, TCP_QUICKACK, tuning->quickack, "TCP_QUICKACK");
+#else
+        success = 0;
+#endif
+    }
+    if (tuning->user_timeout >= 0) {
+#ifdef TCP_USER_TIMEOUT
+        success &= set_tuning_option(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, tuning->user_timeout, "TCP_USER_TIMEOUT");
+#else
+        success = 0;
+#endif
+    }
+    return success;
+}
+
 int enable_keep_alive(sock_t fd, int keepCnt, int keepIdle, int keepIntvl, int enable) {
     int optval = enable ? 1 : 0;
     if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, (void *)&optval, sizeof(optval)) < 0) {
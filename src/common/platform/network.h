@@ -72,6 +72,16 @@ struct sock_addrinfo
   uint16_t                      cached:1;
 };
 
+//Options for a connected tcp socket. A negative value leaves the system default.
+typedef struct socket_tuning {
+    int32_t     nodelay;        //TCP_NODELAY, 0 or 1
+    int32_t     sndbuf;         //SO_SNDBUF in bytes
+    int32_t     rcvbuf;         //SO_RCVBUF in bytes
+    int32_t     notsent_lowat;  //TCP_NOTSENT_LOWAT in bytes
+    int32_t     quickack;       //TCP_QUICKACK, 0 or 1. Linux only, the kernel may fall back to delayed acks later
+    int32_t     user_timeout;   //TCP_USER_TIMEOUT in milliseconds. Linux only
+}socket_tuning;
+
 typedef struct socket_stat {
     uint8_t     success;
     uint8_t     retransmits;
@@ -231,6 +241,29 @@ ssize_t app_send_to(sock_t sock, const void *buf, size_t len, int flags, sockadd
 ssize_t app_recv(sock_t sock, void *buf, size_t len, int flags);
 ssize_t app_recv_from(sock_t sock, void *buf, size_t len, int flags, sockaddr_ip *addr, socklen_t *addrlen);
 
+typedef struct app_datagram {
+    void       *buf;
+    size_t      len;        //capacity for receive, payload length for send. Received length on return.
+    int         truncated;  //the datagram did not fit in buf
+    size_t      segment;    //on receive, the GRO segment size if buf holds several coalesced datagrams, 0 otherwise
+} app_datagram;
+
+//Batched datagram io. recvmmsg/sendmmsg on linux, a loop of recvfrom/sendto elsewhere.
+//Returns the number of datagrams transferred, or -1 with errno set if none were.
+int app_recv_datagrams(sock_t sock, app_datagram *dgrams, int count, int flags);
+int app_send_datagrams(sock_t sock, app_datagram *dgrams, int count, int flags, sockaddr_ip *addr, socklen_t addrlen);
+
+//UDP segmentation offload (linux UDP_SEGMENT / UDP_GRO).
+//app_udp_gso_supported returns 1 if the kernel can split a send into segments.
+//app_udp_enable_gro returns 1 if receives may now return coalesced datagrams,
+// reported through app_datagram.segment.
+//app_send_segments sends count datagrams as one segmented send. All but the
+// last must have the same length, the last may be shorter. Returns count, or -1
+// with errno set. Without UDP_SEGMENT it sets ENOTSUP and sends nothing.
+int app_udp_gso_supported(sock_t sock);
+int app_udp_enable_gro(sock_t sock);
+int app_send_segments(sock_t sock, app_datagram *dgrams, int count, int flags, sockaddr_ip *addr, socklen_t addrlen);
+
 char *app_get_strerror(int err);
 
 int32_t get_macaddress_based_on_ip_address(union sockaddr_ip *addr, char *macaddr, len_t len);
@@ -243,6 +276,9 @@ int32_t set_send_timeout_ms(sock_t socket, uint64_t timeout);
 sa_family_t get_socket_family(sock_t socket);
 int get_socket_type(sock_t socket);
 int enable_keep_alive(sock_t fd, int keepCnt, int keepIdle, int keepIntvl, int enable);
+//Returns 1 if every requested option could be set. Options the platform
+// does not have are skipped and count as failures.
+int apply_socket_tuning(sock_t fd, const socket_tuning *tuning);
 
 #ifdef __WINDOWS_OS__
 #define IsValidSocket(fd) (fd != INVALID_SOCKET)
@@ -85,6 +85,10 @@ PollController::AddFutureTask(TaskSchedule schedule, tDuration timeout, tDuratio
         immediateTaskQueue.push(pollableTask);
         break;
 
+    case TaskSchedule::EndOfIteration:
+        endOfIterationTasks.push_back(pollableTask);
+        break;
+
     default:
         Assert("Unknown taskSchedule types");
 
@@ -99,6 +103,9 @@ tDuration
 PollController::GetNextTaskTimeout(int argTimeout)
 {
     argTimeout = argTimeout < -1 ? -1 : argTimeout;
+    if (endOfIterationTasks.size()) //Deferred from outside of an iteration, do not block.
+        return 0;
+
     PollableTaskPtr task = nullptr;
     while(taskQueue.size()) { //This would clear out unnessary task.
         task = taskQueue.top();
@@ -161,6 +168,19 @@ PollController::ExecuteCurrentTasks()
     }
 }
 
+void
+PollController::ExecuteEndOfIterationTasks()
+{
+    if (endOfIterationTasks.empty())
+        return;
+
+    //Tasks deferred while firing these would run at the end of next iteration
+    std::vector<PollableTaskPtr> tasks;
+    tasks.swap(endOfIterationTasks);
+    for (auto task : tasks)
+        task->Fire();
+}
+
 void
 PollController::CleanupAllTasks()
 {
@@ -175,6 +195,10 @@ PollController::CleanupAllTasks()
         task->DisArm();
         immediateTaskQueue.pop();
     }
+
+    for (auto task : endOfIterationTasks)
+        task->DisArm();
+    endOfIterationTasks.clear();
 }
 
 }; // NameSpace Common
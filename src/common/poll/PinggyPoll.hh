@@ -37,6 +37,7 @@ namespace common {
 enum class TaskSchedule {
     Timer       = 0,
     NextBreak,
+    EndOfIteration,
     // Immediate, //Not being used now
 };
 
@@ -256,6 +257,17 @@ public:
     PollableTaskPtr
     RetainObject(std::shared_ptr<T> t, Args ...args);
 
+    //=========================
+
+    /**
+     * @brief Run the task once after all the events of the current poll
+     *        iteration are handled. It is useful to coalesce work that is
+     *        produced by multiple handlers in the same iteration.
+     */
+    template<typename T, typename ...Args>
+    PollableTaskPtr
+    DeferToEndOfIteration(std::shared_ptr<T> _t, void (T::*func)(Args ...), Args ...args);
+
     virtual tTime
     GetPollTime() final         { return pollTime; }
 
@@ -271,11 +283,15 @@ public:
 
     virtual bool
     HaveFutureTasks(int timeout = -1) final
-                            { return taskQueue.size() > 0 || immediateTaskQueue.size() > 0 || timeout > -1; }
+                            { return taskQueue.size() > 0 || immediateTaskQueue.size() > 0
+                                        || endOfIterationTasks.size() > 0 || timeout > -1; }
 
     virtual void
     ExecuteCurrentTasks() final;
 
+    virtual void
+    ExecuteEndOfIterationTasks() final;
+
 protected:
 
     virtual bool
@@ -293,6 +309,9 @@ private:
     PriorityQueueMinHeap<PollableTaskPtr>
                                 immediateTaskQueue;
 
+    std::vector<PollableTaskPtr>
+                                endOfIterationTasks;
+
     tTime                       pollTime;
     bool                        waitForTask; //Whether poll should wait for task or not when all the fds are gone
 
@@ -384,6 +403,14 @@ PollController::RetainObject(std::shared_ptr<T> t, Args... args)
     return AddFutureTask(TaskSchedule::NextBreak, SECOND, SECOND, false, task);
 }
 
+template<typename T, typename ...Args>
+inline PollableTaskPtr
+PollController::DeferToEndOfIteration(std::shared_ptr<T> _t, void (T::*func)(Args...), Args ...args)
+{
+    auto task = NewFutureTaskImplPtr(_t, func, args...);
+    return AddFutureTask(TaskSchedule::EndOfIteration, 0, MILLISECOND, false, task);
+}
+
 }; //NameSpace Common
 
 #define PinggyTask(x) common::NewFutureTaskImplPtr([&]{x})
@@ -441,6 +441,8 @@ tInt32 PollControllerGeneric::PollOnce(tInt32 argTimeout)
         pollNonPollables();
     }
 
+    ExecuteEndOfIterationTasks();
+
     return 0;
 }
 
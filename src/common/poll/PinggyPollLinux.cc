@@ -173,6 +173,8 @@ tInt32 PollControllerLinux::PollOnce(tInt32 argTimeout)
         pollNonPollables();
     }
 
+    ExecuteEndOfIterationTasks();
+
     return 0;
 }
 
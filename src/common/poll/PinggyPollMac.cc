@@ -179,6 +179,9 @@ tInt32 PollControllerLinux::PollOnce(tInt32 argTimeout)
 
         pollNonPollables();
     }
+
+    ExecuteEndOfIterationTasks();
+
     return 0;
 }
 
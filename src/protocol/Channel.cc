@@ -138,7 +138,14 @@ Channel::Channel(SessionPtr session, SessionFeaturesPtr features) :
             localConsumed(0),
             state(ChannelState_Init),
             allowWrite(false),
-            features(features)
+            datagramMode(false),
+            recvFrontConsumed(false),
+            datagramsDroppedOnSend(0),
+            datagramsDroppedOnRecv(0),
+            features(features),
+            stripeId(0),
+            stats(session->stats),
+            setupStartedAt(0)
 {
 }
 
@@ -152,6 +159,7 @@ Channel::Connect()
     IGNORE_IF_NOT_IN_STATE_RETURN(false, ChannelState_Init);
 
     channelId               = session.lock()->getChannelNewId();
+    datagramMode            = chanType == ChannelType_DataGram && features->IsDatagramChannel();
     auto msg                = NewSetupChannelMsgPtr();
     msg->ChannelId          = channelId;
     msg->ConnectToHost      = destHost;
@@ -163,8 +171,10 @@ Channel::Connect()
     msg->InitialWindowSize  = localWindow;
     msg->MaxDataSize        = localMaxPacket;
 
+    stripeId                = session.lock()->pickStripe();
+    setupStartedAt          = SessionStats::NowInUs();
     session.lock()->registerChannel(thisPtr);
-    session.lock()->sendMsg(msg, true); //It is okay here as we are not going to send any other
+    session.lock()->sendChannelMsg(stripeId, msg); //It is okay here as we are not going to send any other
     state = ChannelState_Connecting;
     if (features->IsFastConnect()) {
         allowWrite = true;
@@ -188,9 +198,10 @@ Channel::Accept()
     msg->InitialWindowSize  = localWindow;
     msg->MaxDataSize        = localMaxPacket;
 
-    session.lock()->sendMsg(msg, true); //It is okay here as we are not going to send any other
+    session.lock()->sendChannelMsg(stripeId, msg); //It is okay here as we are not going to send any other
     state = ChannelState_Connected;
     allowWrite = true;
+    recordSetupLatency();
     return true;
 }
 
@@ -209,7 +220,7 @@ Channel::Reject(tString reason)
     if (features->IsFastConnect())
         session.lock()->deregisterChannel(thisPtr);
 
-    session.lock()->sendMsg(msg, true); //It is okay here as we are not going to send any other
+    session.lock()->sendChannelMsg(stripeId, msg); //It is okay here as we are not going to send any other
     return true;
 }
 
@@ -225,6 +236,9 @@ Channel::Close()
 
     IGNORE_IF_NOT_IN_STATE_RETURN(false, ChannelState_Connected, ChannelState_Close_Responding, ChannelState_Connecting);
 
+    if (datagramMode)
+        flushDatagrams(true); //whatever is queued goes before the close
+
     auto msg = NewChannelCloseMsgPtr();
     msg->ChannelId = channelId;
     sendOrQueue(msg);
@@ -256,6 +270,9 @@ Channel::Send(RawDataPtr rawData)
 
     Assert(rawData->Len > 0);
 
+    if (datagramMode)
+        return sendDatagrams(rawData);
+
     if (remoteWindow < (tUint32)rawData->Len) { //A precausionjust in case we have sent more data than the remote window.
         return -1;
     }
@@ -278,6 +295,7 @@ Channel::Send(RawDataPtr rawData)
     sendOrQueue(msg);
     Assert(workingRawData->Len == 0);
     remoteWindow -= rawData->Len;
+    stats->bytesOut.fetch_add(rawData->Len, std::memory_order_relaxed);
     return rawData->Len;
 }
 
@@ -300,12 +318,15 @@ Channel::Recv(RawData::tLen len)
     if (top->Len > len) {
         raw = top->Slice(0, len);
         top->Consume(len);
+        recvFrontConsumed = true;
     } else {
         raw = top;
-        recvQueue.pop();
+        recvQueue.pop_front();
+        recvFrontConsumed = false;
     }
 
-    adjustWindow(raw->Len);
+    if (!datagramMode)
+        adjustWindow(raw->Len);
 
     return {raw->Len, raw};
 }
@@ -319,6 +340,8 @@ Channel::HaveDataToRead()
 tUint32
 Channel::HaveBufferToWrite()
 {
+    if (datagramMode)
+        return CHANNEL_WINDOW_SIZE; //never blocks, overload is handled by dropping
     return remoteWindow;
 }
 
@@ -336,7 +359,7 @@ Channel::sendOrQueue(ProtoMsgPtr msg)
 {
     auto ev = eventHandler;
 
-    auto success = session.lock()->sendMsg(msg, true);
+    auto success = session.lock()->sendChannelMsg(stripeId, msg);
 
     if (!success) {
         if (ev)
@@ -356,7 +379,9 @@ Channel::adjustWindow(tUint32 len)
         localWindow += sendAdj;
     }
 
-    if (sendAdj) {
+    if (sendAdj && features->IsBatchedWindowAdjust() && session.lock()->pollController) {
+        session.lock()->queueWindowAdjust(channelId, sendAdj);
+    } else if (sendAdj) {
         auto msg = NewChannelWindowAdjustMsgPtr();
         msg->ChannelId = channelId;
         msg->AdditionalBytes = sendAdj;
@@ -364,6 +389,112 @@ Channel::adjustWindow(tUint32 len)
     }
 }
 
+/*
+ * Datagram mode. The data is a sequence of datagrams, each with a 2 byte
+ * length prefix in network order, the same framing UdpConnection uses.
+ * Every datagram goes out in its own ChannelData msg, so a msg is always
+ * a complete datagram and can be dropped on its own. A datagram that is
+ * not complete yet is kept until the rest arrives with the next Send.
+ */
+static inline RawData::tLen
+datagramFrameLength(const char *frame)
+{
+    tUint16 len;
+    memcpy(&len, frame, sizeof(len));
+    return app_ntohs(len) + sizeof(len);
+}
+
+RawData::tLen
+Channel::sendDatagrams(RawDataPtr rawData)
+{
+    auto workingRawData = rawData->Slice(0);
+
+    if (partialDatagram) {
+        if (partialDatagram->Len < 2) {
+            auto take = std::min(2 - partialDatagram->Len, workingRawData->Len);
+            partialDatagram->AddData(workingRawData->GetData(), take);
+            workingRawData->Consume(take);
+            if (partialDatagram->Len < 2)
+                return rawData->Len;
+            auto datagram = NewRawDataPtr(datagramFrameLength(partialDatagram->GetData()));
+            datagram->AddData(partialDatagram->GetData(), 2);
+            partialDatagram = datagram;
+        }
+        auto expected = datagramFrameLength(partialDatagram->GetData());
+        auto take = std::min(expected - partialDatagram->Len, workingRawData->Len);
+        partialDatagram->AddData(workingRawData->GetData(), take);
+        workingRawData->Consume(take);
+        if (partialDatagram->Len < expected)
+            return rawData->Len;
+        auto datagram = partialDatagram;
+        partialDatagram = nullptr;
+        queueDatagram(datagram);
+    }
+
+    while (workingRawData->Len >= 2) {
+        auto frameLen = datagramFrameLength(workingRawData->GetData());
+        if (workingRawData->Len < frameLen)
+            break;
+        queueDatagram(workingRawData->Slice(0, frameLen));
+        workingRawData->Consume(frameLen);
+    }
+
+    if (workingRawData->Len) {
+        auto rest = workingRawData->Len;
+        partialDatagram = NewRawDataPtr(rest >= 2 ? datagramFrameLength(workingRawData->GetData()) : 2);
+        partialDatagram->AddData(workingRawData->GetData(), rest);
+        workingRawData->Consume();
+    }
+
+    flushDatagrams();
+    return rawData->Len;
+}
+
+void
+Channel::queueDatagram(RawDataPtr datagram)
+{
+    if ((tUint32)datagram->Len > remoteMaxPacket) {
+        LOGD(channelId, "Dropping datagram larger than remote max packet:", datagram->Len);
+        datagramsDroppedOnSend++;
+        return;
+    }
+
+    datagramSendQueue.push_back(datagram);
+    if (datagramSendQueue.size() > DATAGRAM_QUEUE_LEN) {
+        datagramSendQueue.pop_front();
+        datagramsDroppedOnSend++;
+    }
+}
+
+/*
+ * Hands queued datagrams to the session as long as the session can put them
+ * on the transport right away. The rest wait here, where they can still be
+ * dropped, until the session calls again from HandleReadyToSendBuffer.
+ * Returns true once nothing is left.
+ */
+bool
+Channel::flushDatagrams(bool force)
+{
+    auto sess = session.lock();
+    if (!sess)
+        return true;
+
+    while (!datagramSendQueue.empty() && (force || sess->canSendChannelMsg(stripeId))) {
+        auto msg        = NewChannelDataMsgPtr();
+        msg->ChannelId  = channelId;
+        msg->Data       = datagramSendQueue.front();
+        datagramSendQueue.pop_front();
+        stats->bytesOut.fetch_add(msg->Data->Len, std::memory_order_relaxed);
+        sendOrQueue(msg);
+    }
+
+    if (datagramSendQueue.empty())
+        return true;
+
+    sess->queueDatagramFlush(channelId);
+    return false;
+}
+
 void
 Channel::handleNewChannelResponse(SetupChannelResponseMsgPtr msg)
 {
@@ -387,9 +518,10 @@ Channel::handleNewChannelResponse(SetupChannelResponseMsgPtr msg)
 
         state = ChannelState_Connected;
         allowWrite = true;
+        recordSetupLatency();
         if (ev) {
             ev->ChannelAccepted(thisPtr);
-            ev->ChannelReadyToSend(thisPtr, remoteWindow);
+            ev->ChannelReadyToSend(thisPtr, HaveBufferToWrite());
         } else {
             LOGE(channelId, ": Event handler required but not found");
         }
@@ -424,14 +556,25 @@ Channel::handleChannelData(ChannelDataMsgPtr dataMsg)
         IGNORE_IF_NOT_IN_STATE_NO_RETURN(ChannelState_Connected, ChannelState_Closing);
     }
 
-    if (localWindow < (tUint32)dataMsg->Data->Len) {
-        LOGF("localWindow:", localWindow, "is not enough for current dataMsg of size", dataMsg->Data->Len);
-        ABORT_WITH_MSG("Invalid size");
-        return;
-    }
+    stats->bytesIn.fetch_add(dataMsg->Data->Len, std::memory_order_relaxed);
 
-    recvQueue.push(dataMsg->Data);
-    localWindow -= dataMsg->Data->Len;
+    if (datagramMode) {
+        if (recvQueue.size() >= DATAGRAM_QUEUE_LEN) {
+            //drop the oldest datagram nobody has started reading
+            recvQueue.erase(recvFrontConsumed ? recvQueue.begin() + 1 : recvQueue.begin());
+            datagramsDroppedOnRecv++;
+        }
+        recvQueue.push_back(dataMsg->Data);
+    } else {
+        if (localWindow < (tUint32)dataMsg->Data->Len) {
+            LOGF("localWindow:", localWindow, "is not enough for current dataMsg of size", dataMsg->Data->Len);
+            ABORT_WITH_MSG("Invalid size");
+            return;
+        }
+
+        recvQueue.push_back(dataMsg->Data);
+        localWindow -= dataMsg->Data->Len;
+    }
 
 
     if (ev)
@@ -441,14 +584,14 @@ Channel::handleChannelData(ChannelDataMsgPtr dataMsg)
 }
 
 void
-Channel::handleChannelWindowAdjust(ChannelWindowAdjustMsgPtr msg)
+Channel::handleChannelWindowAdjust(tUint32 additionalBytes)
 {
     auto ev = eventHandler;
 
     //we are receiving data even after sending close
     IGNORE_IF_NOT_IN_STATE_NO_RETURN(ChannelState_Connected, ChannelState_Close_Responding);
 
-    remoteWindow += msg->AdditionalBytes;
+    remoteWindow += additionalBytes;
 
     if (ev)
         ev->ChannelReadyToSend(thisPtr, remoteWindow);
@@ -515,6 +658,8 @@ Channel::initiateIncomingChannel(SetupChannelMsgPtr msg)
     chanType            = (tChannelType)msg->ChannelType;
     forwardingId        = msg->ForwardingId;
     state               = ChannelState_Connect_Responding;
+    datagramMode        = chanType == ChannelType_DataGram && features->IsDatagramChannel();
+    setupStartedAt      = SessionStats::NowInUs();
 
     if (remoteWindow < remoteMaxPacket)
         ABORT_WITH_MSG("Remote window cannot even keep a single packet. " + std::to_string(remoteWindow) + " < " + std::to_string(remoteMaxPacket));
@@ -532,6 +677,22 @@ Channel::closeTimeoutTriggered()
     session.lock()->deregisterChannel(thisPtr);
 }
 
+/*
+ * Called once the channel reaches Connected. The latency covers the setup
+ * msg and its response, and for an incoming channel the time the handler
+ * took to accept it.
+ */
+void
+Channel::recordSetupLatency()
+{
+    stats->totalChannels.fetch_add(1, std::memory_order_relaxed);
+    if (setupStartedAt) {
+        auto now = SessionStats::NowInUs();
+        stats->AddChannelSetupLatency(now > setupStartedAt ? now - setupStartedAt : 0);
+        setupStartedAt = 0;
+    }
+}
+
 } // namespace protocol
 
 INCLUDE_MEMORY_DUMP_DEFINITION
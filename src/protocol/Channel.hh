@@ -19,6 +19,12 @@
 #include "Schema.hh"
 #include <platform/SharedPtr.hh>
 #include "SessionFeatures.hh"
+#include "SessionStats.hh"
+#include <deque>
+
+//Datagrams a datagram channel keeps per direction before it starts dropping
+// the oldest ones.
+#define DATAGRAM_QUEUE_LEN 256
 
 namespace protocol
 {
@@ -108,6 +114,23 @@ public:
     tForwardingId
     GetForwardingId()           { return forwardingId; }
 
+    tUint8
+    GetStripeId()               { return stripeId; }
+
+    /**
+     * @brief DataGram channel of a session that negotiated datagram channels.
+     *        Such a channel has no flow control window, Send never blocks and
+     *        stale datagrams are dropped under overload.
+     */
+    bool
+    IsDatagramMode()            { return datagramMode; }
+
+    tUint64
+    GetDatagramsDroppedOnSend() { return datagramsDroppedOnSend; }
+
+    tUint64
+    GetDatagramsDroppedOnRecv() { return datagramsDroppedOnRecv; }
+
     void
     SetUserTag(tString tag)     { userTag = tag; }
 
@@ -138,6 +161,15 @@ private:
     void
     adjustWindow(tUint32 len);
 
+    RawData::tLen
+    sendDatagrams(RawDataPtr rawData);
+
+    void
+    queueDatagram(RawDataPtr datagram);
+
+    bool
+    flushDatagrams(bool force = false);
+
     void
     handleNewChannelResponse(SetupChannelResponseMsgPtr);
 
@@ -145,7 +177,7 @@ private:
     handleChannelData(ChannelDataMsgPtr);
 
     void
-    handleChannelWindowAdjust(ChannelWindowAdjustMsgPtr);
+    handleChannelWindowAdjust(tUint32 additionalBytes);
 
     void
     handleChannelClose(ChannelCloseMsgPtr);
@@ -163,6 +195,9 @@ private:
     void
     closeTimeoutTriggered();
 
+    void
+    recordSetupLatency();
+
     friend class                Session;
 
     enum ChannelState {
@@ -195,13 +230,23 @@ private:
     ChannelState                state;
     bool                        allowWrite;
 
-    std::queue<RawDataPtr>      recvQueue;
+    std::deque<RawDataPtr>      recvQueue;
+
+    bool                        datagramMode;
+    bool                        recvFrontConsumed; //front of recvQueue was read partially
+    std::deque<RawDataPtr>      datagramSendQueue;
+    RawDataPtr                  partialDatagram; //a datagram split over several Send
+    tUint64                     datagramsDroppedOnSend;
+    tUint64                     datagramsDroppedOnRecv;
 
     ChannelEventHandlerPtr      eventHandler;
 
     tString                     userTag;
     tVoidPtr                    userPtr;
     SessionFeaturesPtr          features;
+    tUint8                      stripeId; //base connection carrying this channel, 0 is the primary
+    SessionStatsPtr             stats;
+    tUint64                     setupStartedAt; //us, 0 once the setup latency is recorded
 
     friend class                Session;
 };
@@ -22,7 +22,7 @@ namespace protocol
 
 ChannelConnectionForwarder::ChannelConnectionForwarder(ChannelPtr channel, net::NetworkConnectionPtr netConn, DataTransferCounterPtr counter):
                     channel(channel), netConn(netConn), counter(counter),
-                    allowCopyFromChannel(false), allowCopyFromNetConn(false),
+                    counterConnected(false), allowCopyFromChannel(false), allowCopyFromNetConn(false),
                     fdRecvEnabled(false), fdSendEnabled(false)
 {
 }
@@ -35,6 +35,10 @@ ChannelConnectionForwarder::Start()
     if (!channel->IsConnected()) { //It is not yet accepted
         channel->Connect();
     } else {
+        if (counter) { //ChannelAccepted is not going to come for this one
+            counter->CounterChannelConnected(thisPtr);
+            counterConnected = true;
+        }
         if (channel->HaveDataToRead()) {
             netConn->EnableWritePoll();
             fdSendEnabled = true;
@@ -252,6 +256,7 @@ ChannelConnectionForwarder::ChannelRejected(ChannelPtr, tString reason)
     channel = nullptr;
     if (counter) {
         counter->CounterChannelRejected(thisPtr, reason);
+        counter = nullptr;
     }
 }
 
@@ -275,16 +280,16 @@ ChannelConnectionForwarder::ChannelAccepted(ChannelPtr)
     }
     if (counter) {
         counter->CounterChannelConnected(thisPtr);
+        counterConnected = true;
     }
 }
 
 void
 ChannelConnectionForwarder::ChannelCleanup(ChannelPtr)
 {
-    if (counter) {
+    if (counter && counterConnected)
         counter->CounterChannelClosed(thisPtr);
-        counter = nullptr;
-    }
+    counter = nullptr;
 
     if (netConn) {
         netConn->DeregisterFDEvenHandler();
@@ -299,10 +304,9 @@ ChannelConnectionForwarder::ChannelCleanup(ChannelPtr)
 
 void ChannelConnectionForwarder::closeByNetConn()
 {
-    if (counter) {
+    if (counter && counterConnected)
         counter->CounterChannelClosed(thisPtr);
-        counter = nullptr;
-    }
+    counter = nullptr;
 
     if (netConn) {
         netConn->DeregisterFDEvenHandler();
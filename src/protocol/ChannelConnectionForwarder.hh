@@ -20,6 +20,7 @@
 #include <platform/pinggy_types.h>
 #include <poll/PollableFD.hh>
 #include "Channel.hh"
+#include <atomic>
 
 namespace protocol
 {
@@ -49,6 +50,57 @@ public:
 };
 DeclareSharedPtr(DataTransferCounter);
 
+DeclareClassWithSharedPtr(ForwardingCounter);
+
+/*
+ * DataTransferCounter shared by all the forwarders of one forwarding. The
+ * forwarders update it on the poll thread, other threads may read it.
+ */
+class ForwardingCounter: virtual public DataTransferCounter
+{
+public:
+    ForwardingCounter():
+            bytesToChannel(0),
+            bytesToConnection(0),
+            activeChannels(0),
+            totalChannels(0),
+            rejectedChannels(0)
+                                { }
+
+    virtual
+    ~ForwardingCounter()        { }
+
+    virtual void
+    CounterByteCopiedToChannel(ChannelConnectionForwarderPtr, RawData::tLen len) override
+                                { bytesToChannel.fetch_add(len, std::memory_order_relaxed); }
+
+    virtual void
+    CounterByteCopiedToConnection(ChannelConnectionForwarderPtr, RawData::tLen len) override
+                                { bytesToConnection.fetch_add(len, std::memory_order_relaxed); }
+
+    virtual void
+    CounterChannelConnected(ChannelConnectionForwarderPtr) override
+                                { activeChannels.fetch_add(1, std::memory_order_relaxed);
+                                  totalChannels.fetch_add(1, std::memory_order_relaxed); }
+
+    virtual void
+    CounterChannelClosed(ChannelConnectionForwarderPtr) override
+                                { activeChannels.fetch_sub(1, std::memory_order_relaxed); }
+
+    virtual void
+    CounterChannelRejected(ChannelConnectionForwarderPtr, tString) override
+                                { rejectedChannels.fetch_add(1, std::memory_order_relaxed); }
+
+    std::atomic<tUint64>        bytesToChannel;
+    std::atomic<tUint64>        bytesToConnection;
+    std::atomic<tUint32>        activeChannels;
+    std::atomic<tUint64>        totalChannels;
+    std::atomic<tUint64>        rejectedChannels;
+
+    DefineMandatoryClassFunctionsWOSuper(ForwardingCounter);
+};
+DefineMakeSharedPtr(ForwardingCounter);
+
 class ChannelConnectionForwarder:
             virtual public FDEventHandler,
             virtual public ChannelEventHandler
@@ -114,6 +166,7 @@ private:
     ChannelPtr                  channel;
     net::NetworkConnectionPtr   netConn;
     DataTransferCounterPtr      counter;
+    bool                        counterConnected; //Closed is reported only after Connected
 
     bool                        allowCopyFromChannel;
     bool                        allowCopyFromNetConn;
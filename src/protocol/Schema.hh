@@ -177,6 +177,31 @@ enum tChannelType {
     f(Usages,                                                                           \
         arg,                                                                            \
         (ClientSpecificUsagesPtr,   Usages)                                             \
+    )                                                                                   \
+    f(ChannelWindowAdjustBatch,                                                         \
+        arg,                                                                            \
+        (tMsgId,                    MsgId),                                             \
+        (std::vector<tChannelId>,   ChannelIds),                                        \
+        (std::vector<tUint32>,      AdditionalBytes)                                    \
+    )                                                                                   \
+    f(StripeOffer,                                                                      \
+        arg,                                                                            \
+        (tMsgId,                    MsgId),                                             \
+        (tString,                   Token,              "",                         1), \
+        (tUint8,                    MaxStripes,         0,                          1)  \
+    )                                                                                   \
+    f(JoinStripe,                                                                       \
+        arg,                                                                            \
+        (tMsgId,                    MsgId),                                             \
+        (tString,                   Token,              "",                         1), \
+        (tUint8,                    StripeId,           0,                          1)  \
+    )                                                                                   \
+    f(JoinStripeResponse,                                                               \
+        arg,                                                                            \
+        (tMsgId,                    MsgId),                                             \
+        (tUint8,                    StripeId,           0,                          1), \
+        (tUint8,                    Accept,             0,                          1), \
+        (tString,                   Error,              "",                         1)  \
     )
 
 
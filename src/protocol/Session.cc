@@ -18,6 +18,9 @@
 #include "Channel.hh"
 
 
+//keepalives whose send time is remembered, older ones no longer count
+#define MAX_PENDING_KEEPALIVES 16
+
 namespace protocol
 {
 
@@ -30,13 +33,16 @@ Session::Session(net::NetworkConnectionPtr netConn, common::PollControllerPtr po
             keepAliveSentTick(0),
             incomingActivities(false),
             enablePinggyValue(false),
-            pollController(pollController)
+            pollController(pollController),
+            maxStripes(1),
+            nextStripe(0)
 {
     lastChannelId = 4;
     if (asServer)
         lastChannelId += 1;
     lastReqId = 3;
     features = NewSessionFeaturesPtr(PINGGY_SESSION_VERSION);
+    stats = NewSessionStatsPtr();
 }
 
 void
@@ -46,6 +52,14 @@ Session::SetSessionVersion(tUint32 version)
     features->SetVersion(version);
 }
 
+void
+Session::SetStats(SessionStatsPtr stats)
+{
+    Assert(channels.empty());
+    this->stats = stats;
+    updateStatsGauges();
+}
+
 tUint32
 Session::GetSessionVersion()
 {
@@ -80,6 +94,8 @@ Session::End(tString reason)
         auto msg = NewDisconnectMsgPtr(reason);
         sendMsg(msg);
         endSent = true;
+        for (auto entry : stripes)
+            entry.second->transportManager->EndTransport(); //this is not immediate
     }
 }
 
@@ -91,14 +107,19 @@ Session::Cleanup()
         channel->cleanup();
     }
     channels.clear();
+    pendingWindowAdjusts.clear();
+    closeStripes();
 
     closeWriter();
 
-    netConn->DeregisterFDEvenHandler();
-    netConn->CloseConn();
+    if (netConn) { //A session adopted as stripe does not own its connection anymore
+        netConn->DeregisterFDEvenHandler();
+        netConn->CloseConn();
+    }
     netConn = nullptr;
     transportManager = nullptr;
     eventHandler = nullptr;
+    updateStatsGauges();
 }
 
 void
@@ -202,6 +223,9 @@ Session::SendKeepAlive()
 {
     auto msg = NewKeepAliveMsgPtr(keepAliveSentTick);
     keepAliveSentTick += 1;
+    keepAliveSentAt[msg->Tick] = SessionStats::NowInUs();
+    if (keepAliveSentAt.size() > MAX_PENDING_KEEPALIVES)
+        keepAliveSentAt.erase(keepAliveSentAt.begin()); //never going to be answered
     sendMsg(msg);
     return msg->Tick;
 }
@@ -248,12 +272,53 @@ Session::SetSdkEventLogger(net::NetworkConnectionPtr writer)
     msgWriter = writer;
 }
 
+void
+Session::OfferStripes(tString token, tUint8 maxStripes)
+{
+    if (!serverMode || state != SessionState_AuthenticatedAsServer) {
+        ABORT_WITH_MSG("Stripes can be offered by authenticated server only");
+    }
+
+    if (!features->IsStripedSession() || token.empty() || maxStripes < 2)
+        return;
+
+    stripeToken = token;
+    this->maxStripes = maxStripes;
+    sendMsg(NewStripeOfferMsgPtr(token, maxStripes));
+}
+
+bool
+Session::AddStripe(net::NetworkConnectionPtr stripeConn)
+{
+    if (serverMode || state != SessionState_AuthenticatedAsClient || endSent)
+        return false;
+
+    if (!IsStripingAvailable() || GetStripeCount() >= maxStripes)
+        return false;
+
+    tUint8 stripeId = 1;
+    while (stripes.find(stripeId) != stripes.end())
+        stripeId++;
+
+    auto stripe = NewSessionStripePtr(thisPtr, stripeId, stripeConn);
+    stripe->transportManager = NewTransportManagerPtr(stripeConn, stripe);
+    stripe->transportManager->EnablePinggyValueMode(enablePinggyValue);
+    stripeConn->RegisterFDEvenHandler(stripe->transportManager);
+    stripes[stripeId] = stripe;
+
+    LOGD("Joining stripe: ", (tUint32)stripeId);
+    sendOnStripe(stripe, NewJoinStripeMsgPtr(stripeToken, stripeId));
+    return true;
+}
+
 void Session::HandleConnectionReset(net::NetworkConnectionPtr netConn)
 {
     for (auto ch : channels)
         ch.second->cleanup();
 
     channels.clear(); //There will be no callback from transport any more
+    pendingWindowAdjusts.clear();
+    closeStripes();
     if (eventHandler)
         eventHandler->HandleSessionConnectionReset();
 
@@ -266,6 +331,7 @@ void Session::HandleConnectionReset(net::NetworkConnectionPtr netConn)
     }
     transportManager = nullptr;
     eventHandler = nullptr;
+    updateStatsGauges();
 }
 
 void
@@ -303,15 +369,8 @@ Session::HandleReadyToSendBuffer()
 {
     while (!sendQueue.empty()) {
         auto msg = sendQueue.front();
-        bool success = false;
-
-        if (enablePinggyValue) {
-            PinggyValue pv;
-            pv.SetFrom("msg", msg);
-            success = transportManager->SendMsg(pv);
-        } else {
-            success = transportManager->GetSerializer()->Serialize("msg", msg)->Send();
-        }
+        bool success = sendMsgOnTransport(transportManager, msg);
+
         if (success && msg->msgType == MsgType_Disconnect) {
             transportManager->EndTransport(); //this is not immediate
         }
@@ -320,6 +379,10 @@ Session::HandleReadyToSendBuffer()
         }
         sendQueue.pop();
     }
+
+    updateStatsGauges();
+    if (sendQueue.empty())
+        flushDatagramChannels();
 }
 
 #define CHAN_ID_WRAP_VAL 0x3fff
@@ -379,39 +442,250 @@ Session::sendMsg(ProtoMsgPtr msg, bool queue)
 
     bool success = false;
     if (sendQueue.empty()) {
-        if (enablePinggyValue) {
-            PinggyValue pv;
-            pv.SetFrom("msg", msg);
-            success = transportManager->SendMsg(pv);
-        } else {
-            success = transportManager->GetSerializer()->Serialize("msg", msg)->Send();
-        }
+        success = sendMsgOnTransport(transportManager, msg);
     }
     if (success && msg->msgType == MsgType_Disconnect) {
         transportManager->EndTransport(); //this is not immediate
     }
-    if (msgWriter) {
-        if (msgWriter->Write("send: ", 6) <= 0) {
-            closeWriter();
-        } else {
-            auto writer = msgWriter;
-            msg->AddDebugString(writer);
-            if (msgWriter == writer && writer->LastReturn() > 0) {
-                if (msgWriter->Write("\n", 1) <= 0) {
-                    closeWriter();
-                }
-            } else if (msgWriter == writer) {
-                closeWriter();
-            }
-        }
-    }
+    writeDebugMsg("send: ", msg);
     if (!success && queue) {
         sendQueue.push(msg);
+        updateStatsGauges();
         return true;
     }
     return success;
 }
 
+bool
+Session::sendMsgOnTransport(TransportManagerPtr transport, ProtoMsgPtr msg)
+{
+    if (enablePinggyValue) {
+        PinggyValue pv;
+        pv.SetFrom("msg", msg);
+        return transport->SendMsg(pv);
+    }
+    return transport->GetSerializer()->Serialize("msg", msg)->Send();
+}
+
+bool
+Session::sendChannelMsg(tUint8 stripeId, ProtoMsgPtr msg)
+{
+    if (stripeId == 0)
+        return sendMsg(msg, true);
+
+    if (endSent) {
+        LOGE("Cannot send msg, end is already sent.");
+        return false;
+    }
+
+    auto it = stripes.find(stripeId);
+    if (it == stripes.end()) {
+        LOGE("Cannot send msg, stripe is not available: ", (tUint32)stripeId);
+        return false;
+    }
+
+    return sendOnStripe(it->second, msg);
+}
+
+bool
+Session::sendOnStripe(SessionStripePtr stripe, ProtoMsgPtr msg)
+{
+    writeDebugMsg("send: ", msg);
+    if (stripe->sendQueue.empty() && sendMsgOnTransport(stripe->transportManager, msg))
+        return true;
+
+    stripe->sendQueue.push(msg);
+    updateStatsGauges();
+    return true;
+}
+
+/*
+ * Whether a channel msg would go to the transport right away instead of
+ * waiting in a send queue. Datagram channels keep their datagrams (and may
+ * drop them) until this is true.
+ */
+bool
+Session::canSendChannelMsg(tUint8 stripeId)
+{
+    if (endSent)
+        return false;
+
+    if (stripeId == 0)
+        return transportManager && sendQueue.empty();
+
+    auto it = stripes.find(stripeId);
+    return it != stripes.end() && it->second->transportManager && it->second->sendQueue.empty();
+}
+
+void
+Session::queueDatagramFlush(tChannelId channelId)
+{
+    datagramBacklog.insert(channelId);
+}
+
+void
+Session::flushDatagramChannels()
+{
+    auto backlog = datagramBacklog;
+    for (auto channelId : backlog) {
+        auto it = channels.find(channelId);
+        if (it == channels.end() || it->second->flushDatagrams())
+            datagramBacklog.erase(channelId);
+    }
+}
+
+void
+Session::writeDebugMsg(tString direction, ProtoMsgPtr msg)
+{
+    if (!msgWriter)
+        return;
+
+    if (msgWriter->Write(direction.c_str(), direction.length()) <= 0) {
+        closeWriter();
+    } else {
+        auto writer = msgWriter;
+        msg->AddDebugString(writer);
+        if (msgWriter == writer && writer->LastReturn() > 0) {
+            if (msgWriter->Write("\n", 1) <= 0) {
+                closeWriter();
+            }
+        } else if (msgWriter == writer) {
+            closeWriter();
+        }
+    }
+}
+
+/*
+ * New channels are distributed round robin over the primary connection and
+ * the joined stripes.
+ */
+tUint8
+Session::pickStripe()
+{
+    if (stripes.empty())
+        return 0;
+
+    std::vector<tUint8> candidates = {0};
+    for (auto entry : stripes) {
+        if (entry.second->joined)
+            candidates.push_back(entry.first);
+    }
+
+    nextStripe = (nextStripe + 1) % candidates.size();
+    return candidates[nextStripe];
+}
+
+bool
+Session::adoptStripe(SessionPtr joiningSession, tUint8 stripeId)
+{
+    if (!serverMode || state != SessionState_AuthenticatedAsServer || endSent)
+        return false;
+
+    if (!features->IsStripedSession() || stripeToken.empty())
+        return false;
+
+    if (stripeId == 0 || stripes.find(stripeId) != stripes.end() || GetStripeCount() >= maxStripes)
+        return false;
+
+    if (!joiningSession->netConn || !joiningSession->transportManager)
+        return false;
+
+    auto stripe = NewSessionStripePtr(thisPtr, stripeId, joiningSession->netConn);
+    stripe->transportManager = joiningSession->transportManager;
+    stripe->transportManager->SetEventHandler(stripe);
+    stripe->joined = true;
+    stripes[stripeId] = stripe;
+
+    joiningSession->netConn = nullptr;
+    joiningSession->transportManager = nullptr;
+    joiningSession->eventHandler = nullptr;
+
+    sendOnStripe(stripe, NewJoinStripeResponseMsgPtr(stripeId, 1));
+    return true;
+}
+
+void
+Session::handleStripeMsg(SessionStripePtr stripe, ProtoMsgPtr protoMsg)
+{
+    switch (protoMsg->msgType) {
+        case MsgType_ServerHello: //Every server connection starts with a hello. It means nothing for a stripe.
+            break;
+
+        case MsgType_JoinStripeResponse:
+        {
+            auto msg = protoMsg->DynamicPointerCast<JoinStripeResponseMsg>();
+            if (!msg->Accept) {
+                LOGE("Stripe rejected: ", (tUint32)stripe->stripeId, msg->Error);
+                handleStripeReset(stripe);
+                break;
+            }
+            stripe->joined = true;
+            LOGD("Stripe joined: ", (tUint32)stripe->stripeId);
+        }
+        break;
+
+        case MsgType_SetupChannel:
+        case MsgType_SetupChannelResponse:
+        case MsgType_ChannelData:
+        case MsgType_ChannelWindowAdjust:
+        case MsgType_ChannelWindowAdjustBatch:
+        case MsgType_ChannelClose:
+        case MsgType_ChannelError:
+            handleDeserializedMsg(protoMsg, stripe->stripeId);
+            break;
+
+        default:
+            LOGE("Unexpected msg on stripe: ", (tUint32)stripe->stripeId, protoMsg->msgType);
+    }
+}
+
+void
+Session::handleStripeReset(SessionStripePtr stripe)
+{
+    auto stripeId = stripe->stripeId;
+    if (stripes.find(stripeId) == stripes.end())
+        return;
+    stripes.erase(stripeId);
+
+    std::vector<ChannelPtr> affectedChannels;
+    for (auto entry : channels) {
+        if (entry.second->stripeId == stripeId)
+            affectedChannels.push_back(entry.second);
+    }
+    for (auto channel : affectedChannels) {
+        channels.erase(channel->channelId);
+        pendingWindowAdjusts.erase(channel->channelId);
+        channel->cleanup();
+    }
+    updateStatsGauges();
+
+    if (stripe->netConn) {
+        stripe->netConn->DeregisterFDEvenHandler();
+        stripe->netConn->CloseConn();
+        stripe->netConn = nullptr;
+    }
+    stripe->transportManager = nullptr;
+
+    LOGD("Stripe closed: ", (tUint32)stripeId, "channels dropped: ", affectedChannels.size());
+    if (eventHandler)
+        eventHandler->HandleSessionStripeFailed(stripeId);
+}
+
+void
+Session::closeStripes()
+{
+    for (auto entry : stripes) {
+        auto stripe = entry.second;
+        if (stripe->netConn) {
+            stripe->netConn->DeregisterFDEvenHandler();
+            stripe->netConn->CloseConn();
+            stripe->netConn = nullptr;
+        }
+        stripe->transportManager = nullptr;
+    }
+    stripes.clear();
+}
+
 void
 Session::sendErrorMsg(tUint32 errorNo, tString what, bool recoverable)
 {
@@ -440,6 +714,48 @@ Session::deregisterChannel(ChannelPtr channel)
     }
 
     channels.erase(channel->channelId);
+    pendingWindowAdjusts.erase(channel->channelId);
+    datagramBacklog.erase(channel->channelId);
+    updateStatsGauges();
+}
+
+/*
+ * Window adjustments produced during a poll iteration are collected here and
+ * sent as a single ChannelWindowAdjustBatch at the end of the iteration. With
+ * many active channels this saves lots of tiny frames.
+ */
+void
+Session::queueWindowAdjust(tChannelId channelId, tUint32 additionalBytes)
+{
+    if (pendingWindowAdjusts.empty())
+        pollController->DeferToEndOfIteration(thisPtr, &Session::flushWindowAdjusts);
+
+    pendingWindowAdjusts[channelId] += additionalBytes;
+}
+
+void
+Session::flushWindowAdjusts()
+{
+    if (pendingWindowAdjusts.empty())
+        return;
+
+    if (pendingWindowAdjusts.size() == 1) {
+        auto entry = pendingWindowAdjusts.begin();
+        auto msg = NewChannelWindowAdjustMsgPtr();
+        msg->ChannelId = entry->first;
+        msg->AdditionalBytes = entry->second;
+        pendingWindowAdjusts.clear();
+        sendMsg(msg);
+        return;
+    }
+
+    auto msg = NewChannelWindowAdjustBatchMsgPtr();
+    for (auto entry : pendingWindowAdjusts) {
+        msg->ChannelIds.push_back(entry.first);
+        msg->AdditionalBytes.push_back(entry.second);
+    }
+    pendingWindowAdjusts.clear();
+    sendMsg(msg);
 }
 
 void
@@ -451,6 +767,21 @@ Session::registerChannel(ChannelPtr channel)
     }
 
     channels[channel->channelId] = channel;
+    updateStatsGauges();
+}
+
+/*
+ * Gauges are recomputed instead of counted up and down, a send queue or a
+ * channel map that gets dropped as a whole needs no special care this way.
+ */
+void
+Session::updateStatsGauges()
+{
+    size_t depth = transportManager ? sendQueue.size() : 0;
+    for (auto entry : stripes)
+        depth += entry.second->sendQueue.size();
+    stats->activeChannels.store((tUint32)channels.size(), std::memory_order_relaxed);
+    stats->sendQueueDepth.store((tUint32)depth, std::memory_order_relaxed);
 }
 
 void
@@ -465,7 +796,7 @@ Session::handleRemoteForwardResponse(tReqId reqId, tUint8 success, tForwardingId
 }
 
 void
-Session::handleNewChannel(SetupChannelMsgPtr msg)
+Session::handleNewChannel(SetupChannelMsgPtr msg, tUint8 stripeId)
 {
     auto chanType = msg->ChannelType;
     tString rejectMsg = "";
@@ -482,13 +813,14 @@ Session::handleNewChannel(SetupChannelMsgPtr msg)
         chMsg->Accept       = false;
         chMsg->ChannelId    = msg->ChannelId;
         chMsg->Error        = rejectMsg;
-        sendMsg(chMsg);
+        sendChannelMsg(stripeId, chMsg);
         return;
     }
 
     LOGT("New channel request received: ", msg->ChannelId, msg->ConnectToPort);
 
     auto channel            = NewChannelPtr(new Channel(thisPtr, features));
+    channel->stripeId       = stripeId;
     channel->initiateIncomingChannel(msg);
 
     eventHandler->HandleSessionNewChannelRequest(channel);
@@ -514,24 +846,10 @@ Session::closeWriter()
 }
 
 void
-Session::handleDeserializedMsg(ProtoMsgPtr protoMsg)
+Session::handleDeserializedMsg(ProtoMsgPtr protoMsg, tUint8 stripeId)
 {
     incomingActivities = true;
-     if (msgWriter) {
-        if (msgWriter->Write("recv: ", 6) <= 0) {
-            closeWriter();
-        } else {
-            auto writer = msgWriter;
-            protoMsg->AddDebugString(writer);
-            if (msgWriter == writer && writer->LastReturn() > 0) {
-                if (msgWriter->Write("\n", 1) <= 0) {
-                    closeWriter();
-                }
-            } else if (msgWriter == writer) {
-                closeWriter();
-            }
-        }
-    }
+    writeDebugMsg("recv: ", protoMsg);
     switch(protoMsg->msgType) {
         case MsgType_ServerHello:
         {
@@ -608,7 +926,7 @@ Session::handleDeserializedMsg(ProtoMsgPtr protoMsg)
             if (state != SessionState_AuthenticatedAsClient && state != SessionState_AuthenticatedAsServer)
                 ABORT_WITH_MSG("Not expected state");
             auto msg = protoMsg->DynamicPointerCast<SetupChannelMsg>();
-            handleNewChannel(msg);
+            handleNewChannel(msg, stripeId);
         }
         break;
 
@@ -653,7 +971,28 @@ Session::handleDeserializedMsg(ProtoMsgPtr protoMsg)
                 break;
             }
             auto channel = channels.at(msg->ChannelId);
-            channel->handleChannelWindowAdjust(msg);
+            channel->handleChannelWindowAdjust(msg->AdditionalBytes);
+        }
+        break;
+
+        case MsgType_ChannelWindowAdjustBatch:
+        {
+            if (state != SessionState_AuthenticatedAsClient && state != SessionState_AuthenticatedAsServer)
+                ABORT_WITH_MSG("Not expected state");
+            auto msg = protoMsg->DynamicPointerCast<ChannelWindowAdjustBatchMsg>();
+            if (msg->ChannelIds.size() != msg->AdditionalBytes.size()) {
+                LOGE("Malformed window adjust batch: ", msg->ChannelIds.size(), msg->AdditionalBytes.size());
+                break;
+            }
+            for (size_t i = 0; i < msg->ChannelIds.size(); i++) {
+                auto channelId = msg->ChannelIds[i];
+                if (channels.find(channelId) == channels.end()) {
+                    LOGD("Ignoring channel window adjust as it is not registered: ", channelId);
+                    continue;
+                }
+                auto channel = channels.at(channelId);
+                channel->handleChannelWindowAdjust(msg->AdditionalBytes[i]);
+            }
         }
         break;
 
@@ -711,6 +1050,12 @@ Session::handleDeserializedMsg(ProtoMsgPtr protoMsg)
         case MsgType_KeepAliveResponse:
         {
             auto msg = protoMsg->DynamicPointerCast<KeepAliveResponseMsg>();
+            auto sent = keepAliveSentAt.find(msg->ForTick);
+            if (sent != keepAliveSentAt.end()) {
+                auto now = SessionStats::NowInUs();
+                stats->AddKeepAliveRtt(now > sent->second ? now - sent->second : 0);
+                keepAliveSentAt.erase(keepAliveSentAt.begin(), ++sent); //responses come in order
+            }
             eventHandler->HandleSessionKeepAliveResponseReceived(msg->ForTick);
         }
         break;
@@ -731,11 +1076,104 @@ Session::handleDeserializedMsg(ProtoMsgPtr protoMsg)
         }
         break;
 
+        case MsgType_StripeOffer:
+        {
+            if (state != SessionState_AuthenticatedAsClient)
+                ABORT_WITH_MSG("Not expected state");
+            auto msg = protoMsg->DynamicPointerCast<StripeOfferMsg>();
+            if (!features->IsStripedSession()) {
+                LOGD("Ignoring stripe offer as striping is not negotiated");
+                break;
+            }
+            stripeToken = msg->Token;
+            maxStripes = msg->MaxStripes;
+            eventHandler->HandleSessionStripesOffered(maxStripes);
+        }
+        break;
+
+        case MsgType_JoinStripe:
+        {
+            if (!serverMode || state != SessionState_ServerHelloSent)
+                ABORT_WITH_MSG("Not expected state");
+            auto msg = protoMsg->DynamicPointerCast<JoinStripeMsg>();
+            auto primary = eventHandler->HandleSessionStripeJoinRequest(msg->Token, msg->StripeId);
+            if (primary && primary != thisPtr && primary->adoptStripe(thisPtr, msg->StripeId)) {
+                state = SessionState_Init; //this session does not own anything anymore
+                break;
+            }
+            sendMsg(NewJoinStripeResponseMsgPtr(msg->StripeId, 0, "Stripe rejected"));
+            End("Stripe rejected");
+        }
+        break;
+
         default:
             ABORT_WITH_MSG("Unhandled msg");
     }
 }
 
+//==============
+
+SessionStripe::SessionStripe(SessionPtr session, tUint8 stripeId, net::NetworkConnectionPtr netConn):
+            session(session),
+            stripeId(stripeId),
+            netConn(netConn),
+            joined(false)
+{
+}
+
+void
+SessionStripe::HandleConnectionReset(net::NetworkConnectionPtr)
+{
+    auto sess = session.lock();
+    if (sess)
+        sess->handleStripeReset(thisPtr);
+}
+
+void
+SessionStripe::HandleIncomingDeserialize(DeserializerPtr deserializer)
+{
+    ProtoMsgPtr msg;
+    deserializer->Deserialize("msg", msg);
+    auto sess = session.lock();
+    if (sess)
+        sess->handleStripeMsg(thisPtr, msg);
+}
+
+void
+SessionStripe::HandleIncomingPinggyValue(PinggyValue &pv)
+{
+    ProtoMsgPtr msg;
+    pv.GetTo("msg", msg);
+    auto sess = session.lock();
+    if (sess)
+        sess->handleStripeMsg(thisPtr, msg);
+}
+
+void
+SessionStripe::HandleIncompleteHandshake()
+{
+    HandleConnectionReset(netConn);
+}
+
+void
+SessionStripe::HandleReadyToSendBuffer()
+{
+    auto sess = session.lock();
+    if (!sess)
+        return;
+
+    while (!sendQueue.empty() && transportManager) {
+        auto msg = sendQueue.front();
+        if (!sess->sendMsgOnTransport(transportManager, msg))
+            break;
+        sendQueue.pop();
+    }
+
+    sess->updateStatsGauges();
+    if (sendQueue.empty())
+        sess->flushDatagramChannels();
+}
+
 } // namespace protocol
 
 INCLUDE_MEMORY_DUMP_DEFINITION
@@ -23,6 +23,7 @@
 #include "Channel.hh"
 #include "Schema.hh"
 #include <queue>
+#include <set>
 #include "SessionFeatures.hh"
 #include <poll/PinggyPoll.hh>
 
@@ -109,9 +110,77 @@ public:
     virtual void
     HandleSessionUsages(ClientSpecificUsagesPtr usages)
                                 { ABORT_WITH_MSG("Not implemented"); }
+
+    virtual void
+    HandleSessionStripesOffered(tUint8 maxStripes)
+                                { }
+
+    /**
+     * @brief Server side only. A new connection wants to join an existing
+     *        session as a stripe. Return the session the token belongs to.
+     */
+    virtual SessionPtr
+    HandleSessionStripeJoinRequest(tString token, tUint8 stripeId)
+                                { return nullptr; }
+
+    virtual void
+    HandleSessionStripeFailed(tUint8 stripeId)
+                                { LOGE("Stripe failed: ", (tUint32)stripeId); }
 };
 DeclareSharedPtr(SessionEventHandler);
 
+DeclareClassWithSharedPtr(SessionStripe);
+
+/*
+ * An additional base connection of a session. Channels are pinned to one
+ * stripe for their whole life, so messages of a channel never get reordered.
+ * Everything else (auth, forwarding, keepalive) stays on the primary
+ * connection owned by the Session itself.
+ */
+class SessionStripe: virtual public TransportManagerEventHandler
+{
+public:
+    SessionStripe(SessionPtr session, tUint8 stripeId, net::NetworkConnectionPtr netConn);
+
+    virtual
+    ~SessionStripe()            { }
+
+    tUint8
+    GetStripeId()               { return stripeId; }
+
+    bool
+    IsJoined()                  { return joined; }
+
+// TransportManagerEventHandler
+    virtual void
+    HandleConnectionReset(net::NetworkConnectionPtr netConn) override;
+
+    virtual void
+    HandleIncomingDeserialize(DeserializerPtr deserializer) override;
+
+    virtual void
+    HandleIncomingPinggyValue(PinggyValue &) override;
+
+    virtual void
+    HandleIncompleteHandshake() override;
+
+    virtual void
+    HandleReadyToSendBuffer() override;
+
+    DefineMandatoryClassFunctionsWOSuper(SessionStripe);
+
+private:
+    friend class                Session;
+
+    SessionWPtr                 session;
+    tUint8                      stripeId;
+    net::NetworkConnectionPtr   netConn;
+    TransportManagerPtr         transportManager;
+    std::queue<ProtoMsgPtr>     sendQueue;
+    bool                        joined;
+};
+DefineMakeSharedPtr(SessionStripe);
+
 class Session: virtual public TransportManagerEventHandler
 {
 public:
@@ -207,6 +276,39 @@ public:
     void
     SetSdkEventLogger(net::NetworkConnectionPtr writer);
 
+    /**
+     * @brief Server side. Let the client add more base connections to this session.
+     * @param token The client has to present this token while joining.
+     * @param maxStripes Maximum number of base connections including the primary one.
+     */
+    virtual void
+    OfferStripes(tString token, tUint8 maxStripes);
+
+    /**
+     * @brief Client side. Join a freshly connected base connection to this session.
+     *        Works only after the server offered stripes.
+     * @return false if striping is not possible at this moment.
+     */
+    virtual bool
+    AddStripe(net::NetworkConnectionPtr stripeConn);
+
+    bool
+    IsStripingAvailable()       { return features->IsStripedSession() && !stripeToken.empty(); }
+
+    tUint8
+    GetMaxStripes()             { return maxStripes; }
+
+    tUint8
+    GetStripeCount()            { return (tUint8)(stripes.size() + 1); }
+
+    SessionStatsPtr
+    GetStats()                  { return stats; }
+
+    // Share the counters with an earlier session, e.g. the one this session
+    // replaces after a reconnection. Must be set before any channel exists.
+    void
+    SetStats(SessionStatsPtr stats);
+
 // TransportManagerEventHandler
     virtual void
     HandleConnectionReset(net::NetworkConnectionPtr netConn) override;
@@ -238,6 +340,42 @@ private:
     bool
     sendMsg(ProtoMsgPtr, bool queue = true);
 
+    bool
+    sendMsgOnTransport(TransportManagerPtr transport, ProtoMsgPtr msg);
+
+    bool
+    sendChannelMsg(tUint8 stripeId, ProtoMsgPtr msg);
+
+    bool
+    sendOnStripe(SessionStripePtr stripe, ProtoMsgPtr msg);
+
+    bool
+    canSendChannelMsg(tUint8 stripeId);
+
+    void
+    queueDatagramFlush(tChannelId channelId);
+
+    void
+    flushDatagramChannels();
+
+    void
+    writeDebugMsg(tString direction, ProtoMsgPtr msg);
+
+    tUint8
+    pickStripe();
+
+    bool
+    adoptStripe(SessionPtr joiningSession, tUint8 stripeId);
+
+    void
+    handleStripeMsg(SessionStripePtr stripe, ProtoMsgPtr msg);
+
+    void
+    handleStripeReset(SessionStripePtr stripe);
+
+    void
+    closeStripes();
+
     void
     sendErrorMsg(tUint32 errorNo, tString what, bool recoverable=false);
 
@@ -247,6 +385,12 @@ private:
     void
     deregisterChannel(ChannelPtr channel);
 
+    void
+    queueWindowAdjust(tChannelId channelId, tUint32 additionalBytes);
+
+    void
+    flushWindowAdjusts();
+
     void
     registerChannel(ChannelPtr channel);
 
@@ -255,7 +399,7 @@ private:
                                     std::vector<RemoteForwardingPtr> remoteForwardings, tString error);
 
     void
-    handleNewChannel(SetupChannelMsgPtr newChannelMsg);
+    handleNewChannel(SetupChannelMsgPtr newChannelMsg, tUint8 stripeId);
 
     common::PollableTaskPtr
     setupChannelCloseTimeout(ChannelPtr);
@@ -264,9 +408,13 @@ private:
     closeWriter();
 
     void
-    handleDeserializedMsg(ProtoMsgPtr tMsg);
+    updateStatsGauges();
+
+    void
+    handleDeserializedMsg(ProtoMsgPtr tMsg, tUint8 stripeId = 0);
 
     friend class                Channel;
+    friend class                SessionStripe;
 
     net::NetworkConnectionPtr   netConn;
     TransportManagerPtr         transportManager;
@@ -283,11 +431,21 @@ private:
     bool                        endSent;
     tString                     endReason;
     tUint64                     keepAliveSentTick;
+    std::map<tUint64, tUint64>  keepAliveSentAt; //tick -> us, keepalives waiting for the response
     bool                        incomingActivities;
     bool                        enablePinggyValue;
     SessionFeaturesPtr          features;
     common::PollControllerPtr   pollController;
     net::NetworkConnectionPtr   msgWriter;
+    std::map<tChannelId, tUint32>
+                                pendingWindowAdjusts;
+    std::set<tChannelId>        datagramBacklog; //datagram channels waiting for the transport
+    std::map<tUint8, SessionStripePtr>
+                                stripes;
+    tString                     stripeToken;
+    tUint8                      maxStripes;
+    tUint8                      nextStripe;
+    SessionStatsPtr             stats;
 };
 DefineMakeSharedPtr(Session);
 
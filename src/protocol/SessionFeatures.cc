@@ -48,6 +48,12 @@ SessionFeatures::configureFeatures()
     resetToDefault();
     switch (version)
     {
+    case PINGGY_SESSION_VERSION_1_05:
+        datagramChannel = true;
+    case PINGGY_SESSION_VERSION_1_04:
+        stripedSession = true;
+    case PINGGY_SESSION_VERSION_1_03:
+        batchedWindowAdjust = true;
     case PINGGY_SESSION_VERSION_1_02:
         primaryForwardingMode = false;
     case PINGGY_SESSION_VERSION_1_01:
@@ -69,6 +75,9 @@ SessionFeatures::resetToDefault()
     closeTimeOutChannel = false;
     primaryForwardingMode = true;
     implicitUsagesAndGreeting = false;
+    batchedWindowAdjust = false;
+    stripedSession = false;
+    datagramChannel = false;
 }
 
 } // namespace protocol
@@ -24,10 +24,13 @@
 #define PINGGY_SESSION_VERSION_1_00 0x1000
 #define PINGGY_SESSION_VERSION_1_01 0x1001
 #define PINGGY_SESSION_VERSION_1_02 0x1002
+#define PINGGY_SESSION_VERSION_1_03 0x1003
+#define PINGGY_SESSION_VERSION_1_04 0x1004
+#define PINGGY_SESSION_VERSION_1_05 0x1005
 
 
 #ifndef PINGGY_SESSION_VERSION
-#define PINGGY_SESSION_VERSION PINGGY_SESSION_VERSION_1_02 //major minor
+#define PINGGY_SESSION_VERSION PINGGY_SESSION_VERSION_1_05 //major minor
 #endif
 
 namespace protocol
@@ -86,6 +89,31 @@ public:
     IsPrimaryForwardingModeEnabled()
                                 { return primaryForwardingMode; }
 
+    /**
+     * @brief Whether window adjustments of multiple channels can be sent together
+     *        in a single ChannelWindowAdjustBatch msg.
+     * @return
+     */
+    const bool
+    IsBatchedWindowAdjust()     { return batchedWindowAdjust; }
+
+    /**
+     * @brief Whether a session can spread its channels over multiple base connections (stripes).
+     *        Each channel stays on a single stripe, so ordering within a channel is kept.
+     * @return
+     */
+    const bool
+    IsStripedSession()          { return stripedSession; }
+
+    /**
+     * @brief Whether DataGram channels run without flow control windows. Every
+     *        ChannelData msg carries exactly one datagram and both ends drop the
+     *        oldest datagrams instead of queueing without bound.
+     * @return
+     */
+    const bool
+    IsDatagramChannel()         { return datagramChannel; }
+
     DefineMandatoryClassFunctionsWOSuper(SessionFeatures);
 
 private:
@@ -105,6 +133,12 @@ private:
     bool                        primaryForwardingMode = true;
                 //whether usage already present in the protocol or not
     bool                        implicitUsagesAndGreeting = false;
+                //window adjustments are coalesced across channels
+    bool                        batchedWindowAdjust = false;
+                //additional base connections can join the session
+    bool                        stripedSession = false;
+                //datagram channels skip windowing and drop under overload
+    bool                        datagramChannel = false;
 };
 DefineMakeSharedPtr(SessionFeatures);
 
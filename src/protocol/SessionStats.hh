@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SRC_CPP_PROTOCOL_SESSIONSTATS_HH_
+#define SRC_CPP_PROTOCOL_SESSIONSTATS_HH_
+
+#include <platform/pinggy_types.h>
+#include <platform/SharedPtr.hh>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+//Bucket i of a latency histogram counts samples below 2^i microseconds. The
+// last bucket takes everything above.
+#define LATENCY_HISTOGRAM_BUCKETS 32
+
+//The keepalive rtt is unstable while its mean deviation is above this
+// percentage of the smoothed rtt.
+#define KEEPALIVE_RTT_UNSTABLE_PERCENT 25
+
+//The deviation starts at half of the first sample (RFC 6298) and needs a few
+// steady samples to fall below the threshold. Before that it says nothing.
+#define KEEPALIVE_RTT_MIN_SAMPLES 4
+
+namespace protocol
+{
+
+/*
+ * Histogram of latencies in microseconds with power of two buckets. One
+ * thread adds, any thread may read.
+ */
+struct LatencyHistogram
+{
+    LatencyHistogram()
+                                { for (auto &bucket : buckets) bucket.store(0, std::memory_order_relaxed); }
+
+    void
+    Add(tUint64 us);
+
+    // Upper bound of the bucket holding the given percentile (0-100), 0 if
+    // there is no sample.
+    tUint64
+    GetPercentile(tUint32 percentile);
+
+    std::atomic<tUint64>        buckets[LATENCY_HISTOGRAM_BUCKETS];
+};
+
+DeclareStructWithSharedPtr(SessionStats);
+
+/*
+ * Counters of a session. The poll thread updates them with relaxed atomics,
+ * any other thread may read them at the same time. A reader gets a
+ * consistent value of each counter, not of the whole set. The sdk keeps one
+ * SessionStats over all the sessions of a tunnel, so the counters survive a
+ * reconnection while the gauges are reset by the new session.
+ */
+struct SessionStats: virtual public pinggy::SharedObject
+{
+    SessionStats():
+            bytesIn(0),
+            bytesOut(0),
+            totalChannels(0),
+            activeChannels(0),
+            sendQueueDepth(0),
+            keepAliveRtt(0),
+            keepAliveSrtt(0),
+            keepAliveRttVar(0),
+            keepAliveRttMin(0),
+            keepAliveRttMax(0),
+            keepAliveSamples(0)
+                                { }
+
+    virtual
+    ~SessionStats()             { }
+
+    static tUint64
+    NowInUs()                   { return std::chrono::duration_cast<std::chrono::microseconds>(
+                                            std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+    void
+    AddChannelSetupLatency(tUint64 us)
+                                { channelSetupLatency.Add(us); }
+
+    void
+    AddKeepAliveRtt(tUint64 us);
+
+    bool
+    IsKeepAliveRttUnstable();
+
+    std::atomic<tUint64>        bytesIn; //channel payload received
+    std::atomic<tUint64>        bytesOut; //channel payload sent
+    std::atomic<tUint64>        totalChannels;
+    std::atomic<tUint32>        activeChannels;
+    std::atomic<tUint32>        sendQueueDepth; //msgs waiting for the transport, all the stripes together
+    LatencyHistogram            channelSetupLatency;
+
+    //keepalive rtt in us. The smoothed rtt and the mean deviation follow
+    // the tcp retransmission timer (RFC 6298).
+    std::atomic<tUint64>        keepAliveRtt; //latest sample
+    std::atomic<tUint64>        keepAliveSrtt;
+    std::atomic<tUint64>        keepAliveRttVar;
+    std::atomic<tUint64>        keepAliveRttMin;
+    std::atomic<tUint64>        keepAliveRttMax;
+    std::atomic<tUint64>        keepAliveSamples;
+    LatencyHistogram            keepAliveRttHistogram;
+
+    DefineMandatoryClassFunctionsWOSuper(SessionStats);
+};
+DefineMakeSharedPtr(SessionStats);
+
+inline void
+LatencyHistogram::Add(tUint64 us)
+{
+    tUint32 bucket = 0;
+    while (bucket < LATENCY_HISTOGRAM_BUCKETS - 1 && (us >> bucket) != 0)
+        bucket++;
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+inline tUint64
+LatencyHistogram::GetPercentile(tUint32 percentile)
+{
+    tUint64 counts[LATENCY_HISTOGRAM_BUCKETS];
+    tUint64 total = 0;
+    for (tUint32 i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0)
+        return 0;
+
+    tUint64 rank = (total * std::min(percentile, (tUint32)100) + 99) / 100;
+    if (rank == 0)
+        rank = 1;
+    tUint64 seen = 0;
+    for (tUint32 i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank)
+            return ((tUint64)1) << i;
+    }
+    return ((tUint64)1) << (LATENCY_HISTOGRAM_BUCKETS - 1);
+}
+
+inline void
+SessionStats::AddKeepAliveRtt(tUint64 us)
+{
+    auto samples = keepAliveSamples.load(std::memory_order_relaxed);
+    auto srtt = keepAliveSrtt.load(std::memory_order_relaxed);
+    auto rttVar = keepAliveRttVar.load(std::memory_order_relaxed);
+
+    if (samples == 0) {
+        srtt = us;
+        rttVar = us / 2;
+        keepAliveRttMin.store(us, std::memory_order_relaxed);
+        keepAliveRttMax.store(us, std::memory_order_relaxed);
+    } else {
+        auto deviation = srtt > us ? srtt - us : us - srtt;
+        rttVar = (3 * rttVar + deviation) / 4;
+        srtt = (7 * srtt + us) / 8;
+        if (us < keepAliveRttMin.load(std::memory_order_relaxed))
+            keepAliveRttMin.store(us, std::memory_order_relaxed);
+        if (us > keepAliveRttMax.load(std::memory_order_relaxed))
+            keepAliveRttMax.store(us, std::memory_order_relaxed);
+    }
+
+    keepAliveRtt.store(us, std::memory_order_relaxed);
+    keepAliveSrtt.store(srtt, std::memory_order_relaxed);
+    keepAliveRttVar.store(rttVar, std::memory_order_relaxed);
+    keepAliveRttHistogram.Add(us);
+    keepAliveSamples.store(samples + 1, std::memory_order_relaxed);
+}
+
+inline bool
+SessionStats::IsKeepAliveRttUnstable()
+{
+    if (keepAliveSamples.load(std::memory_order_relaxed) < KEEPALIVE_RTT_MIN_SAMPLES)
+        return false;
+    auto srtt = keepAliveSrtt.load(std::memory_order_relaxed);
+    auto rttVar = keepAliveRttVar.load(std::memory_order_relaxed);
+    return rttVar * 100 > srtt * KEEPALIVE_RTT_UNSTABLE_PERCENT;
+}
+
+} // namespace protocol
+
+#endif // SRC_CPP_PROTOCOL_SESSIONSTATS_HH_
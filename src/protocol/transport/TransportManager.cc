@@ -275,6 +275,10 @@ TransportManager::EndTransport()
         return true;
     endTransport = true;
     if (senderQueue.empty()) {
+        if (!sendersNetConn->Flush() && sendersNetConn->TryAgain()) {
+            sendersNetConn->EnableWritePoll(); //close once the buffered data is out
+            return true;
+        }
         closeConnections();
     }
     return true;
@@ -341,7 +345,18 @@ len_t
 TransportManager::HandleFDWrite(PollableFDPtr)
 {
     if (senderQueue.empty()) {
+        if (!sendersNetConn->Flush()) { //lower layer may still hold coalesced data
+            if (sendersNetConn->TryAgain())
+                return -1;
+            if (eventHandler)
+                eventHandler->HandleConnectionReset(sendersNetConn);
+            return 0;
+        }
         sendersNetConn->DisableWritePoll();
+        if (endTransport) {
+            closeConnections();
+            return -1;
+        }
         if(eventHandler)
             eventHandler->HandleReadyToSendBuffer();
         return 0;
@@ -367,6 +382,8 @@ TransportManager::HandleFDWrite(PollableFDPtr)
     }
     if (senderQueue.empty()) {
         if (endTransport) {
+            if (!sendersNetConn->Flush() && sendersNetConn->TryAgain())
+                return sent;
             closeConnections();
             return -1;
         }
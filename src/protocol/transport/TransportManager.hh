@@ -113,6 +113,10 @@ public:
     EnablePinggyValueMode(bool enable = true)
                                 { enablePinggyValue = enable; }
 
+    inline void
+    SetEventHandler(TransportManagerEventHandlerPtr handler)
+                                { eventHandler = handler; }
+
     virtual SerializerPtr
     GetSerializer();
 
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __SRC_CPP_SDK_COMMANDQUEUE_HH__
+#define __SRC_CPP_SDK_COMMANDQUEUE_HH__
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <platform/Log.hh>
+
+namespace sdk
+{
+
+/*
+ * Commands posted to the tunnel thread by other threads. Any thread may push,
+ * only the thread holding the tunnel lock runs them. Push is a CAS on the
+ * head of a singly linked list; RunAll takes the whole list at once, so the
+ * consumer never races with the producers over single nodes.
+ */
+class CommandQueue
+{
+public:
+    typedef std::function<void()> tCommand;
+
+    CommandQueue(): head(nullptr)
+                                { }
+
+    ~CommandQueue()
+    {
+        auto node = head.exchange(nullptr);
+        while (node) {
+            auto next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    // Returns true when the queue was empty, i.e. the consumer needs a wake up.
+    bool
+    Push(tCommand command)
+    {
+        auto node = new Node{std::move(command), nullptr};
+        auto expected = head.load(std::memory_order_relaxed);
+        do {
+            node->next = expected;
+        } while (!head.compare_exchange_weak(expected, node, std::memory_order_release, std::memory_order_relaxed));
+        return expected == nullptr; // node may be gone already, do not touch it
+    }
+
+    bool
+    IsEmpty()                   { return head.load(std::memory_order_acquire) == nullptr; }
+
+    // Runs the queued commands in the order they were pushed.
+    int
+    RunAll()
+    {
+        Node *node = head.exchange(nullptr, std::memory_order_acquire);
+
+        Node *ordered = nullptr;
+        while (node) {
+            auto next = node->next;
+            node->next = ordered;
+            ordered = node;
+            node = next;
+        }
+
+        int count = 0;
+        while (ordered) {
+            auto next = ordered->next;
+            try {
+                ordered->command();
+            } catch (const std::exception &e) {
+                LOGE("Command failed:", e.what());
+            }
+            delete ordered;
+            ordered = next;
+            count++;
+        }
+        return count;
+    }
+
+private:
+    struct Node
+    {
+        tCommand                command;
+        Node                   *next;
+    };
+
+    std::atomic<Node *>         head;
+};
+
+} // namespace sdk
+
+#endif // __SRC_CPP_SDK_COMMANDQUEUE_HH__
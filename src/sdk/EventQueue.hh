@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __SRC_CPP_SDK_EVENTQUEUE_HH__
+#define __SRC_CPP_SDK_EVENTQUEUE_HH__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include <platform/SharedPtr.hh>
+#include <platform/network.h>
+#include "pinggy.h"
+
+#define EVENT_QUEUE_DEFAULT_CAPACITY    1024
+#define EVENT_QUEUE_MAX_CAPACITY        (1u << 20)
+
+
+/*
+ * Ring of tunnel events for applications which pull events instead of
+ * receiving callbacks. Events are pushed by the tunnel thread (or a thread
+ * holding the tunnel lock) and drained by one application thread.
+ *
+ * A full ring drops the event and reports TunnelEvent_Overflow on the next
+ * poll. The wake up fd (eventfd on linux, a socketpair elsewhere) becomes
+ * readable when events are waiting and is cleared by PollEvents.
+ */
+class ApiEventQueue: virtual public pinggy::SharedObject
+{
+public:
+    explicit
+    ApiEventQueue(pinggy_uint32_t capacity):
+                            head(0),
+                            tail(0),
+                            overflowed(false),
+                            signaled(false),
+                            readFd(InValidSocket),
+                            writeFd(InValidSocket)
+    {
+        pinggy_uint32_t size = 1;
+        while (size < capacity && size < EVENT_QUEUE_MAX_CAPACITY)
+            size <<= 1;
+        ring.resize(size);
+        mask = size - 1;
+
+#ifdef __linux__
+        readFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        writeFd = readFd;
+#else
+        sock_t fds[2];
+        if (app_socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0) {
+            readFd = fds[0];
+            writeFd = fds[1];
+            set_blocking(readFd, 0);
+            set_blocking(writeFd, 0);
+        }
+#endif
+    }
+
+    virtual
+    ~ApiEventQueue()
+    {
+        if (writeFd != readFd)
+            CloseNCleanSocket(writeFd);
+        CloseNCleanSocket(readFd);
+    }
+
+    sock_t
+    GetFd()                     { return readFd; }
+
+    bool
+    Push(const pinggy_tunnel_event_t &event)
+    {
+        auto h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= ring.size()) {
+            overflowed.store(true, std::memory_order_relaxed);
+            signal();
+            return false;
+        }
+        ring[h & mask] = event;
+        head.store(h + 1, std::memory_order_release);
+        signal();
+        return true;
+    }
+
+    // timeoutMs: 0 returns immediately, negative waits until an event arrives.
+    pinggy_uint32_t
+    PollEvents(pinggy_tunnel_event_t *events, pinggy_uint32_t maxEvents, pinggy_int32_t timeoutMs)
+    {
+        if (maxEvents == 0)
+            return 0;
+
+        clearSignal();
+        auto count = drain(events, maxEvents);
+        if (count > 0 || timeoutMs == 0)
+            return count;
+
+        {
+            std::unique_lock<std::mutex> lock(waitLock);
+            auto ready = [this]() { return signaled.load(); };
+            if (timeoutMs < 0)
+                waitCondition.wait(lock, ready);
+            else
+                waitCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+        }
+
+        clearSignal();
+        return drain(events, maxEvents);
+    }
+
+    DefineMandatoryClassFunctionsNoDump(ApiEventQueue);
+
+private:
+    std::vector<pinggy_tunnel_event_t>
+                                ring;
+    uint64_t                    mask;
+    std::atomic<uint64_t>       head;
+    std::atomic<uint64_t>       tail;
+    std::atomic<bool>           overflowed;
+    std::atomic<bool>           signaled;
+    sock_t                      readFd;
+    sock_t                      writeFd;
+    std::mutex                  waitLock;
+    std::condition_variable     waitCondition;
+
+    // Only the first event after the consumer cleared the signal touches
+    // the fd and the condition variable.
+    pinggy_void_t
+    signal()
+    {
+        if (signaled.exchange(true))
+            return;
+
+        uint64_t one = 1;
+#ifdef __linux__
+        [[maybe_unused]] auto ret = write(writeFd, &one, sizeof(one));
+#else
+        [[maybe_unused]] auto ret = app_send(writeFd, &one, 1, 0);
+#endif
+
+        std::lock_guard<std::mutex> lock(waitLock);
+        waitCondition.notify_all();
+    }
+
+    // The fd is drained before the flag is cleared. The other way round, a
+    // producer signalling in between would have its write consumed while the
+    // flag stays set, and no later Push would touch the fd again. Events
+    // pushed before the flag is cleared are picked up by the drain after it.
+    pinggy_void_t
+    clearSignal()
+    {
+        uint64_t buf[8];
+#ifdef __linux__
+        [[maybe_unused]] auto ret = read(readFd, buf, sizeof(buf[0]));
+#else
+        while (app_recv(readFd, buf, sizeof(buf), 0) > 0)
+            ;
+#endif
+
+        signaled.exchange(false, std::memory_order_acq_rel);
+    }
+
+    pinggy_uint32_t
+    drain(pinggy_tunnel_event_t *events, pinggy_uint32_t maxEvents)
+    {
+        pinggy_uint32_t count = 0;
+        if (overflowed.exchange(false, std::memory_order_relaxed)) {
+            events[count] = {};
+            events[count].type = TunnelEvent_Overflow;
+            count++;
+        }
+
+        auto t = tail.load(std::memory_order_relaxed);
+        auto h = head.load(std::memory_order_acquire);
+        while (t < h && count < maxEvents)
+            events[count++] = ring[(t++) & mask];
+        tail.store(t, std::memory_order_release);
+
+        // Events left behind for the next call must keep the fd readable.
+        if (t < h)
+            signal();
+
+        return count;
+    }
+};
+DefineMakeSharedPtr(ApiEventQueue);
+
+#endif // __SRC_CPP_SDK_EVENTQUEUE_HH__
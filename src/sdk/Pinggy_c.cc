@@ -16,11 +16,13 @@
 
 
 #include "Sdk.hh"
+#include "SdkRuntime.hh"
 #include <shared_mutex>
 #include <exception>
 #include <platform/app_foreach_macro.h>
 
 #define PINGGY_TYPETEST_ENABLED
+#include "EventQueue.hh"
 #include "RefTable.hh"
 #include "pinggy.h"
 
@@ -54,6 +56,30 @@ pinggy_set_log_enable(pinggy_bool_t val)
     SetGlobalLogEnable(val != 0);
 }
 
+PINGGY_EXPORT pinggy_void_t
+pinggy_set_async_log_enable(pinggy_bool_t enable, pinggy_uint32_t ring_size)
+{
+    EnableAsyncLog(enable != 0, ring_size ? ring_size : ASYNC_LOG_RING_SIZE);
+}
+
+PINGGY_EXPORT pinggy_uint64_t
+pinggy_get_log_dropped_count()
+{
+    return GetDroppedLogCount();
+}
+
+PINGGY_EXPORT pinggy_void_t
+pinggy_set_log_level(pinggy_log_module_t module, pinggy_log_level_t level)
+{
+    SetLogLevel(module, level);
+}
+
+PINGGY_EXPORT pinggy_log_level_t
+pinggy_get_log_level(pinggy_log_module_t module)
+{
+    return (pinggy_log_level_t)GetLogLevel(module);
+}
+
 
 PINGGY_EXPORT pinggy_bool_t
 pinggy_is_interrupted()
@@ -102,6 +128,7 @@ GetObjFuncs(Sdk);
 GetObjFuncs(SDKConfig);
 // GetObjFuncs2(PollController, common::PollController);
 GetObjFuncs(SdkChannelWraper);
+GetObjFuncs(SdkRuntime);
 
 #undef GetObjFuncs
 #undef GetObjFuncs2
@@ -124,6 +151,8 @@ struct ApiChannelEventHandler: public virtual sdk::SdkChannelEventHandler
     pinggy_void_p_t             channelCleanupUserData;
 
     pinggy_ref_t                channelRef;
+    pinggy_ref_t                tunnelRef;
+    ApiEventQueuePtr            eventQueue;
 
     ApiChannelEventHandler():
                             channelDataReceivedCB(NULL),
@@ -134,12 +163,21 @@ struct ApiChannelEventHandler: public virtual sdk::SdkChannelEventHandler
                             channelReadyToSendUserData(NULL),
                             channelErrorUserData(NULL),
                             channelCleanupUserData(NULL),
-                            channelRef(INVALID_PINGGY_REF)
+                            channelRef(INVALID_PINGGY_REF),
+                            tunnelRef(INVALID_PINGGY_REF)
                                 { }
 
+    pinggy_void_t
+    queueEvent(pinggy_tunnel_event_type_t type, pinggy_uint32_t value = 0)
+    {
+        if (eventQueue)
+            eventQueue->Push({type, tunnelRef, channelRef, value});
+    }
+
     virtual pinggy_void_t
     ChannelDataReceived(sdk::SdkChannelWraperPtr) override
     {
+        queueEvent(TunnelEvent_ChannelDataReceived);
         if (!channelDataReceivedCB) return;
         channelDataReceivedCB(channelDataReceivedUserData, channelRef);
     }
@@ -147,6 +185,7 @@ struct ApiChannelEventHandler: public virtual sdk::SdkChannelEventHandler
     virtual pinggy_void_t
     ChannelReadyToSend(sdk::SdkChannelWraperPtr, tUint32 bufferLen) override
     {
+        queueEvent(TunnelEvent_ChannelReadyToSend, bufferLen);
         if (!channelReadyToSendCB) return;
         channelReadyToSendCB(channelReadyToSendUserData, channelRef, bufferLen);
     }
@@ -154,6 +193,7 @@ struct ApiChannelEventHandler: public virtual sdk::SdkChannelEventHandler
     virtual pinggy_void_t
     ChannelError(sdk::SdkChannelWraperPtr, tString errorText) override
     {
+        queueEvent(TunnelEvent_ChannelError);
         if (!channelErrorCB) return;
         channelErrorCB(channelErrorUserData, channelRef, errorText.c_str(), errorText.length());
     }
@@ -161,6 +201,7 @@ struct ApiChannelEventHandler: public virtual sdk::SdkChannelEventHandler
     virtual pinggy_void_t
     ChannelCleanup(sdk::SdkChannelWraperPtr) override
     {
+        queueEvent(TunnelEvent_ChannelCleanup);
         if (!channelCleanupCB) return;
         channelCleanupCB(channelCleanupUserData, channelRef);
         pinggy_free_ref(channelRef);
@@ -171,6 +212,33 @@ struct ApiChannelEventHandler: public virtual sdk::SdkChannelEventHandler
 };
 DefineMakeSharedPtr(ApiChannelEventHandler)
 
+//==============================================================
+// Wraps an application buffer given to pinggy_tunnel_channel_send_owned.
+// Slices keep it alive, the buffer goes back to the application when the
+// last of them is gone.
+struct ApiOwnedRawData: public RawData
+{
+    pinggy_channel_data_free_cb_t
+                                freeCB;
+    pinggy_void_p_t             freeUserData;
+
+    ApiOwnedRawData(pinggy_char_p_t data, RawData::tLen len, pinggy_channel_data_free_cb_t freeCB, pinggy_void_p_t freeUserData):
+                            RawData(data, len, false),
+                            freeCB(freeCB),
+                            freeUserData(freeUserData)
+                                { }
+
+    virtual
+    ~ApiOwnedRawData()
+    {
+        if (freeCB)
+            freeCB(freeUserData, Data);
+    }
+
+    DefineMandatoryClassFunctionsNoDump(ApiOwnedRawData);
+};
+DefineMakeSharedPtr(ApiOwnedRawData)
+
 //==============================================================
 struct ApiEventHandler: virtual public sdk::SdkEventHandler
 {
@@ -212,6 +280,7 @@ public:
     pinggy_void_p_t             onUsageUpdateUserData;
 
     pinggy_ref_t                sdk;
+    ApiEventQueuePtr            eventQueue;
 
     ApiEventHandler():
                         onTunnelEstablishedCB(NULL),
@@ -244,6 +313,13 @@ public:
 
     virtual ~ApiEventHandler()  { }
 
+    pinggy_void_t
+    queueEvent(pinggy_tunnel_event_type_t type, pinggy_ref_t channelRef = INVALID_PINGGY_REF, pinggy_uint32_t value = 0)
+    {
+        if (eventQueue)
+            eventQueue->Push({type, sdk, channelRef, value});
+    }
+
 #define GetCStringArray(cVec,vec)                               \
         auto cVec = new pinggy_char_p_t[vec.size()+2];          \
         for (size_t i = 0; i < vec.size(); ++i) {               \
@@ -259,6 +335,7 @@ public:
     virtual pinggy_void_t
     OnTunnelEstablished(std::vector<tString> urls) override
     {
+        queueEvent(TunnelEvent_TunnelEstablished);
         if (!onTunnelEstablishedCB) {
             LOGD("onTunnelEstablishedCB does not exists");
             return;
@@ -270,6 +347,7 @@ public:
     virtual pinggy_void_t
     OnTunnelFailed(tString message) override
     {
+        queueEvent(TunnelEvent_TunnelFailed);
         if (!onTunnelFailedCB) return;
         onTunnelFailedCB(onTunnelFailedUserData, sdk, message.c_str());
     }
@@ -295,6 +373,7 @@ public:
     virtual pinggy_void_t
     OnDisconnected(tString error, std::vector<tString> messages) override
     {
+        queueEvent(TunnelEvent_Disconnected);
         if (!onDisconnectedCB) return;
         GetCStringArray(cMsg, messages);
         onDisconnectedCB(onDisconnectedUserData, sdk, error.c_str(), messages.size(), cMsg);
@@ -332,17 +411,27 @@ public:
     virtual pinggy_void_t
     OnHandleError(tUint32 errorNo, tString what, tBool recoverable) override
     {
+        queueEvent(TunnelEvent_Error, INVALID_PINGGY_REF, errorNo);
         if (!onErrorCB) return;
         onErrorCB(onErrorUserData, sdk, errorNo, what.c_str(), recoverable?1:0);
     }
     virtual bool
     OnNewVisitorConnectionReceived(sdk::SdkChannelWraperPtr channel) override
     {
-        if (!onNewChannelCB) return false;
+        if (!onNewChannelCB && !eventQueue) return false;
         auto channelRef             = getRef(channel);
         auto channelHandler         = NewApiChannelEventHandlerPtr();
         channelHandler->channelRef  = channelRef;
+        channelHandler->tunnelRef   = sdk;
+        channelHandler->eventQueue  = eventQueue;
         channel->RegisterEventHandler(channelHandler);
+        if (!onNewChannelCB) {
+            // The application accepts or rejects it once it reads the event.
+            if (eventQueue->Push({TunnelEvent_NewChannel, sdk, channelRef, 0}))
+                return true;
+            pinggy_free_ref(channelRef);
+            return false;
+        }
         auto ret = onNewChannelCB(onNewChannelUserData, sdk, channelRef) ? true : false;
         if (ret == false)
             pinggy_free_ref(channelRef);
@@ -352,6 +441,7 @@ public:
     virtual pinggy_void_t
     OnUsageUpdate(tString update) override
     {
+        queueEvent(TunnelEvent_UsageUpdate);
         if (!onUsageUpdateCB) return;
         onUsageUpdateCB(onUsageUpdateUserData, sdk, update.c_str());
     }
@@ -613,6 +703,92 @@ pinggy_config_set_reconnect_interval(pinggy_ref_t ref, pinggy_uint16_t interval)
         sdkConf->SetAutoReconnectInterval(interval);
     );
 }
+
+PINGGY_EXPORT pinggy_void_t
+pinggy_config_set_connection_stripes(pinggy_ref_t ref, pinggy_uint16_t stripes)
+{
+    auto sdkConf = getSDKConfig(ref);
+    if (!sdkConf) {
+        LOGE("No sdkConf found for the ref:", ref);
+        return;
+    }
+    ExpectException(
+        sdkConf->SetConnectionStripes((tUint8)std::min(stripes, (pinggy_uint16_t)MAX_CONNECTION_STRIPES));
+    );
+}
+
+PINGGY_EXPORT pinggy_void_t
+pinggy_config_set_upstream_pool_size(pinggy_ref_t ref, pinggy_uint16_t pool_size)
+{
+    auto sdkConf = getSDKConfig(ref);
+    if (!sdkConf) {
+        LOGE("No sdkConf found for the ref:", ref);
+        return;
+    }
+    ExpectException(
+        sdkConf->SetUpstreamPoolSize(pool_size);
+    );
+}
+
+PINGGY_EXPORT pinggy_void_t
+pinggy_config_set_keepalive_probe_interval(pinggy_ref_t ref, pinggy_uint16_t interval)
+{
+    auto sdkConf = getSDKConfig(ref);
+    if (!sdkConf) {
+        LOGE("No sdkConf found for the ref:", ref);
+        return;
+    }
+    ExpectException(
+        sdkConf->SetKeepAliveProbeInterval(interval);
+    );
+}
+
+static pinggy_int32_t *
+socketTuningOption(net::SocketTuning &tuning, pinggy_socket_tuning_option_t option)
+{
+    switch (option) {
+    case SocketTuningOption_NoDelay:
+        return &tuning.nodelay;
+    case SocketTuningOption_SendBuffer:
+        return &tuning.sndbuf;
+    case SocketTuningOption_RecvBuffer:
+        return &tuning.rcvbuf;
+    case SocketTuningOption_NotSentLowat:
+        return &tuning.notsent_lowat;
+    case SocketTuningOption_QuickAck:
+        return &tuning.quickack;
+    case SocketTuningOption_UserTimeout:
+        return &tuning.user_timeout;
+    }
+    return NULL;
+}
+
+PINGGY_EXPORT pinggy_void_t
+pinggy_config_set_socket_tuning(pinggy_ref_t ref, pinggy_socket_tuning_target_t target, pinggy_socket_tuning_option_t option, pinggy_int32_t value)
+{
+    auto sdkConf = getSDKConfig(ref);
+    if (!sdkConf) {
+        LOGE("No sdkConf found for the ref:", ref);
+        return;
+    }
+    if (target != SocketTuningTarget_Base && target != SocketTuningTarget_Upstream) {
+        LOGE("Unknown socket tuning target:", target);
+        return;
+    }
+    auto tuning = target == SocketTuningTarget_Base ? sdkConf->GetBaseSocketTuning() : sdkConf->GetUpstreamSocketTuning();
+    auto field = socketTuningOption(tuning, option);
+    if (!field) {
+        LOGE("Unknown socket tuning option:", option);
+        return;
+    }
+    *field = value < 0 ? -1 : value;
+    ExpectException(
+        if (target == SocketTuningTarget_Base)
+            sdkConf->SetBaseSocketTuning(tuning);
+        else
+            sdkConf->SetUpstreamSocketTuning(tuning);
+    );
+}
 //======
 
 PINGGY_EXPORT pinggy_void_t
@@ -962,6 +1138,56 @@ pinggy_config_get_reconnect_interval(pinggy_ref_t ref)
     return sdkConf->GetAutoReconnectInterval();
 }
 
+PINGGY_EXPORT pinggy_uint16_t
+pinggy_config_get_connection_stripes(pinggy_ref_t ref)
+{
+    auto sdkConf = getSDKConfig(ref);
+    if (!sdkConf) {
+        LOGE("No sdkConf found for the ref:", ref);
+        return 0;
+    }
+    return sdkConf->GetConnectionStripes();
+}
+
+PINGGY_EXPORT pinggy_uint16_t
+pinggy_config_get_upstream_pool_size(pinggy_ref_t ref)
+{
+    auto sdkConf = getSDKConfig(ref);
+    if (!sdkConf) {
+        LOGE("No sdkConf found for the ref:", ref);
+        return 0;
+    }
+    return sdkConf->GetUpstreamPoolSize();
+}
+
+PINGGY_EXPORT pinggy_uint16_t
+pinggy_config_get_keepalive_probe_interval(pinggy_ref_t ref)
+{
+    auto sdkConf = getSDKConfig(ref);
+    if (!sdkConf) {
+        LOGE("No sdkConf found for the ref:", ref);
+        return 0;
+    }
+    return sdkConf->GetKeepAliveProbeInterval();
+}
+
+PINGGY_EXPORT pinggy_int32_t
+pinggy_config_get_socket_tuning(pinggy_ref_t ref, pinggy_socket_tuning_target_t target, pinggy_socket_tuning_option_t option)
+{
+    auto sdkConf = getSDKConfig(ref);
+    if (!sdkConf) {
+        LOGE("No sdkConf found for the ref:", ref);
+        return -1;
+    }
+    if (target != SocketTuningTarget_Base && target != SocketTuningTarget_Upstream) {
+        LOGE("Unknown socket tuning target:", target);
+        return -1;
+    }
+    auto tuning = target == SocketTuningTarget_Base ? sdkConf->GetBaseSocketTuning() : sdkConf->GetUpstreamSocketTuning();
+    auto field = socketTuningOption(tuning, option);
+    return field ? *field : -1;
+}
+
 //====
 
 PINGGY_EXPORT pinggy_const_int_t
@@ -1135,6 +1361,51 @@ pinggy_tunnel_initiate(pinggy_ref_t ref)
     return sdkRef;
 }
 
+PINGGY_EXPORT pinggy_ref_t
+pinggy_runtime_create(pinggy_uint16_t num_reactors)
+{
+    ExpectException(
+        auto runtime = sdk::NewSdkRuntimePtr(num_reactors);
+        return getRef(runtime);
+    );
+    return INVALID_PINGGY_REF;
+}
+
+PINGGY_EXPORT pinggy_ref_t
+pinggy_tunnel_initiate_in_runtime(pinggy_ref_t runtimeRef, pinggy_ref_t configRef, pinggy_int32_t reactor)
+{
+    auto runtime = getSdkRuntime(runtimeRef);
+    if (!runtime) {
+        LOGE("No runtime found for the ref:", runtimeRef);
+        return INVALID_PINGGY_REF;
+    }
+    if (reactor >= runtime->GetReactorCount()) {
+        LOGE("No such reactor in the runtime:", reactor);
+        return INVALID_PINGGY_REF;
+    }
+    auto sdkRef = pinggy_tunnel_initiate(configRef);
+    auto sdk = getSdk(sdkRef);
+    if (!sdk)
+        return INVALID_PINGGY_REF;
+    sdk->SetRuntime(runtime, reactor);
+    return sdkRef;
+}
+
+PINGGY_EXPORT pinggy_bool_t
+pinggy_runtime_stop(pinggy_ref_t ref)
+{
+    auto runtime = getSdkRuntime(ref);
+    if (!runtime) {
+        LOGE("No runtime found for the ref:", ref);
+        return pinggy_false;
+    }
+    ExpectException(
+        runtime->Stop();
+        return pinggy_true;
+    );
+    return pinggy_false;
+}
+
 pinggy_bool_t
 pinggy_tunnel_start_isblocking(pinggy_ref_t ref, bool blocking)
 {
@@ -1337,6 +1608,53 @@ pinggy_tunnel_get_current_usages_len(pinggy_ref_t ref, pinggy_capa_t capa, pingg
     CopyStringToOutputLen(capa, val, sdk->GetCurrentUsages(), max_len);
 }
 
+PINGGY_EXPORT pinggy_bool_t
+pinggy_tunnel_get_stats(pinggy_ref_t ref, pinggy_stats_t *stats)
+{
+    auto sdk =  getSdk(ref);
+    if (sdk == nullptr) {
+        LOGE("null sdk");
+        return pinggy_false;
+    }
+    if (!stats)
+        return pinggy_false;
+
+    auto snapshot = sdk->GetStats();
+    memset(stats, 0, sizeof(*stats));
+    stats->bytes_in                     = snapshot.bytesIn;
+    stats->bytes_out                    = snapshot.bytesOut;
+    stats->total_channels               = snapshot.totalChannels;
+    stats->channel_setup_latency_p50    = snapshot.channelSetupLatencyP50;
+    stats->channel_setup_latency_p90    = snapshot.channelSetupLatencyP90;
+    stats->channel_setup_latency_p99    = snapshot.channelSetupLatencyP99;
+    stats->keepalive_rtt                = snapshot.keepAliveRtt;
+    stats->keepalive_rtt_smoothed       = snapshot.keepAliveSrtt;
+    stats->keepalive_rtt_variance       = snapshot.keepAliveRttVar;
+    stats->keepalive_rtt_min            = snapshot.keepAliveRttMin;
+    stats->keepalive_rtt_max            = snapshot.keepAliveRttMax;
+    stats->keepalive_rtt_p50            = snapshot.keepAliveRttP50;
+    stats->keepalive_rtt_p90            = snapshot.keepAliveRttP90;
+    stats->keepalive_rtt_p99            = snapshot.keepAliveRttP99;
+    stats->keepalive_samples            = snapshot.keepAliveSamples;
+    stats->active_channels              = snapshot.activeChannels;
+    stats->send_queue_depth             = snapshot.sendQueueDepth;
+    stats->reconnects                   = snapshot.reconnects;
+    stats->tls_handshakes               = snapshot.tlsHandshakes;
+    stats->tls_sessions_resumed         = snapshot.tlsSessionsResumed;
+    for (auto &fwd : snapshot.forwardings) {
+        if (stats->num_forwardings >= PINGGY_STATS_MAX_FORWARDINGS)
+            break;
+        auto &entry = stats->forwardings[stats->num_forwardings++];
+        entry.forwarding_id             = fwd.forwardingId;
+        entry.active_channels           = fwd.activeChannels;
+        entry.bytes_to_local            = fwd.bytesToLocal;
+        entry.bytes_from_local          = fwd.bytesFromLocal;
+        entry.total_channels            = fwd.totalChannels;
+        entry.rejected_channels         = fwd.rejectedChannels;
+    }
+    return pinggy_true;
+}
+
 PINGGY_EXPORT pinggy_const_int_t
 pinggy_tunnel_get_greeting_msgs(pinggy_ref_t ref, pinggy_capa_t capa, pinggy_char_p_t val)
 {
@@ -1555,6 +1873,54 @@ pinggy_tunnel_set_on_usage_update_callback(pinggy_ref_t sdkRef, pinggy_on_usage_
     return pinggy_true;
 }
 
+PINGGY_EXPORT pinggy_bool_t
+pinggy_tunnel_enable_event_queue(pinggy_ref_t sdkRef, pinggy_uint32_t capacity)
+{
+    GetEventHandlerFromSdkRef(sdkRef, aev);
+    if (sdk->IsTunnelActive()) {
+        LOGE("Event queue has to be enabled before starting the tunnel");
+        return pinggy_false;
+    }
+    if (!aev->eventQueue)
+        aev->eventQueue = NewApiEventQueuePtr(capacity ? capacity : EVENT_QUEUE_DEFAULT_CAPACITY);
+    return pinggy_true;
+}
+
+static ApiEventQueuePtr
+getEventQueue(pinggy_ref_t sdkRef)
+{
+    auto sdk = getSdk(sdkRef);
+    if (sdk == nullptr) {
+        LOGE("null sdk");
+        return nullptr;
+    }
+    auto ev = sdk->GetSdkEventHandler();
+    auto aev = ev ? ev->DynamicPointerCast<ApiEventHandler>() : nullptr;
+    if (aev == nullptr || aev->eventQueue == nullptr) {
+        LOGE("Event queue is not enabled for the tunnel");
+        return nullptr;
+    }
+    return aev->eventQueue;
+}
+
+PINGGY_EXPORT pinggy_int32_t
+pinggy_tunnel_poll_events(pinggy_ref_t sdkRef, pinggy_tunnel_event_t *events, pinggy_uint32_t max_events, pinggy_int32_t timeout_ms)
+{
+    auto eventQueue = getEventQueue(sdkRef);
+    if (!eventQueue || !events)
+        return -1;
+    return (pinggy_int32_t)eventQueue->PollEvents(events, max_events, timeout_ms);
+}
+
+PINGGY_EXPORT pinggy_int32_t
+pinggy_tunnel_get_event_fd(pinggy_ref_t sdkRef)
+{
+    auto eventQueue = getEventQueue(sdkRef);
+    if (!eventQueue)
+        return -1;
+    return (pinggy_int32_t)eventQueue->GetFd();
+}
+
 #undef GetEventHandlerFromSdkRef
 
 
@@ -1663,6 +2029,21 @@ pinggy_tunnel_channel_send(pinggy_ref_t channelRef, pinggy_const_char_p_t data,
     return (pinggy_raw_len_t)channel->Send(rawData);
 }
 
+PINGGY_EXPORT pinggy_raw_len_t
+pinggy_tunnel_channel_send_owned(pinggy_ref_t channelRef, pinggy_char_p_t data, pinggy_raw_len_t len, pinggy_channel_data_free_cb_t free_cb, pinggy_void_p_t user_data)
+{
+    auto rawData = NewApiOwnedRawDataPtr(data, len, free_cb, user_data);
+
+    auto channel = getSdkChannelWraper(channelRef);
+    if (!channel)
+        return -1; //TODO raise exception
+
+    if (len <= 0)
+        return len;
+
+    return (pinggy_raw_len_t)channel->Send(rawData);
+}
+
 PINGGY_EXPORT pinggy_raw_len_t
 pinggy_tunnel_channel_recv(pinggy_ref_t channelRef, pinggy_char_p_t data, pinggy_raw_len_t len)
 {
@@ -1685,6 +2066,116 @@ pinggy_tunnel_channel_recv(pinggy_ref_t channelRef, pinggy_char_p_t data, pinggy
     return rawData->Len;
 }
 
+PINGGY_EXPORT pinggy_raw_len_t
+pinggy_tunnel_channel_recv_borrow(pinggy_ref_t channelRef, pinggy_raw_len_t max_len, pinggy_const_char_p_t *data)
+{
+    auto channel = getSdkChannelWraper(channelRef);
+    if (!channel)
+        return -1; //TODO raise exception
+
+    if (!data)
+        return -1;
+
+    if (max_len <= 0)
+        return max_len;
+
+    return channel->Borrow(max_len, data);
+}
+
+PINGGY_EXPORT pinggy_bool_t
+pinggy_tunnel_channel_release(pinggy_ref_t channelRef, pinggy_const_char_p_t data)
+{
+    auto channel = getSdkChannelWraper(channelRef);
+    if (!channel)
+        return pinggy_false;
+
+    return channel->Release(data) ? pinggy_true : pinggy_false;
+}
+
+PINGGY_EXPORT pinggy_raw_len_t
+pinggy_tunnel_channel_sendv(pinggy_ref_t channelRef, const pinggy_iovec_t *iov, pinggy_uint32_t iov_count)
+{
+    auto channel = getSdkChannelWraper(channelRef);
+    if (!channel)
+        return -1; //TODO raise exception
+
+    if (!iov)
+        return -1;
+
+    std::vector<RawDataPtr> buffers;
+    buffers.reserve(iov_count);
+    for (pinggy_uint32_t i = 0; i < iov_count; i++) {
+        if (iov[i].len > 0)
+            buffers.push_back(NewRawDataNoCopyPtr(iov[i].base, iov[i].len));
+    }
+    if (buffers.empty())
+        return 0;
+
+    return (pinggy_raw_len_t)channel->SendV(buffers);
+}
+
+PINGGY_EXPORT pinggy_raw_len_t
+pinggy_tunnel_channel_recvv(pinggy_ref_t channelRef, const pinggy_iovec_t *iov, pinggy_uint32_t iov_count)
+{
+    auto channel = getSdkChannelWraper(channelRef);
+    if (!channel)
+        return -1; //TODO raise exception
+
+    if (!iov)
+        return -1;
+
+    std::vector<std::tuple<pinggy_char_p_t, RawData::tLen>> buffers;
+    buffers.reserve(iov_count);
+    for (pinggy_uint32_t i = 0; i < iov_count; i++) {
+        if (iov[i].len > 0)
+            buffers.push_back({(pinggy_char_p_t)iov[i].base, iov[i].len});
+    }
+    if (buffers.empty())
+        return 0;
+
+    return (pinggy_raw_len_t)channel->RecvV(buffers);
+}
+
+PINGGY_EXPORT pinggy_int32_t
+pinggy_tunnel_channels_poll(pinggy_ref_t tunnelRef, pinggy_channel_poll_t *channels, pinggy_uint32_t count)
+{
+    auto sdk = getSdk(tunnelRef);
+    if (!sdk) {
+        LOGE("null sdk");
+        return -1;
+    }
+
+    if (!channels)
+        return -1;
+
+    return sdk->Run([&]() {
+        pinggy_int32_t ready = 0;
+        for (pinggy_uint32_t i = 0; i < count; i++) {
+            auto &entry = channels[i];
+            entry.readable  = pinggy_false;
+            entry.connected = pinggy_false;
+            entry.writable  = 0;
+
+            auto channel = getSdkChannelWraper(entry.channel);
+            if (!channel)
+                continue;
+
+            //The state of another tunnel's channel belongs to its own thread
+            if (channel->GetSdk() != sdk) {
+                LOGE("Channel", entry.channel, "does not belong to the tunnel", tunnelRef);
+                continue;
+            }
+
+            entry.readable  = channel->HaveDataToRead() ? pinggy_true : pinggy_false;
+            entry.connected = channel->IsConnected() ? pinggy_true : pinggy_false;
+            entry.writable  = channel->HaveBufferToWrite();
+            if (entry.readable || entry.writable)
+                ready++;
+        }
+        return ready;
+    });
+}
+
 PINGGY_EXPORT pinggy_bool_t
 pinggy_tunnel_channel_have_data_to_recv(pinggy_ref_t channelRef)
 {
@@ -1,54 +1,152 @@
+#include <atomic>
 #include <cstdint>
 #include <memory>
-#include <mutex>
-#include <queue>
-#include <vector>
+#include <thread>
 
 #include <platform/SharedPtr.hh>
+#include <platform/assert_pinggy.h>
 #include "pinggy.h"
 
 
+/*
+ * A ref is the slot index (low REF_TABLE_INDEX_BITS bits) and the generation
+ * of the slot (remaining bits). Generation is never 0, so a valid ref is
+ * never INVALID_PINGGY_REF. Releasing a ref bumps the generation, so a stale
+ * ref does not resolve to the object that reuses the slot.
+ *
+ * Slots live in chunks which are allocated once and never move. GetObj does
+ * not lock: it announces itself in the slot's reader count, checks the ref
+ * and copies the object. RemoveRef invalidates the ref first and then waits
+ * for the readers of the slot to finish before dropping the object.
+ */
+#define REF_TABLE_INDEX_BITS        20
+#define REF_TABLE_INDEX_MASK        ((1u << REF_TABLE_INDEX_BITS) - 1)
+#define REF_TABLE_GENERATION_MASK   ((1u << (32 - REF_TABLE_INDEX_BITS)) - 1)
+#define REF_TABLE_CHUNK_BITS        10
+#define REF_TABLE_CHUNK_SIZE        (1u << REF_TABLE_CHUNK_BITS)
+#define REF_TABLE_MAX_CHUNKS        (1u << (REF_TABLE_INDEX_BITS - REF_TABLE_CHUNK_BITS))
 
 class RefTable
 {
 private:
-    std::vector<tVoidPtr>       table;
-    std::queue<pinggy_ref_t>    freeList;
-    std::mutex                  lock;
+    struct Slot
+    {
+        std::atomic<pinggy_ref_t>   ref{INVALID_PINGGY_REF};
+        std::atomic<pinggy_uint32_t>
+                                    readers{0};
+        std::atomic<pinggy_uint32_t>
+                                    nextFree{0}; // index + 1, 0 ends the list
+        pinggy_uint32_t             generation = 0;
+        tVoidPtr                    obj;
+    };
+
+    std::atomic<Slot *>         chunks[REF_TABLE_MAX_CHUNKS];
+    std::atomic<pinggy_uint32_t>
+                                used;
+    std::atomic<uint64_t>       freeHead; // tag << 32 | (index + 1)
+
+    // Slot of an index handed out by allocate(), its chunk exists.
+    Slot &
+    slotAt(pinggy_uint32_t index)
+    {
+        auto chunk = chunks[index >> REF_TABLE_CHUNK_BITS].load(std::memory_order_acquire);
+        Assert(chunk);
+        return chunk[index & (REF_TABLE_CHUNK_SIZE - 1)];
+    }
 
-    pinggy_void_t
-    grow()
+    // Slot of a ref from the caller, which may be anything.
+    Slot *
+    slotForRef(pinggy_ref_t ref)
+    {
+        if (ref == INVALID_PINGGY_REF)
+            return nullptr;
+        auto index = ref & REF_TABLE_INDEX_MASK;
+        auto chunk = chunks[index >> REF_TABLE_CHUNK_BITS].load(std::memory_order_acquire);
+        if (!chunk)
+            return nullptr;
+        return &chunk[index & (REF_TABLE_CHUNK_SIZE - 1)];
+    }
+
+    bool
+    popFree(pinggy_uint32_t &index)
     {
-        pinggy_uint32_t oldSize = static_cast<pinggy_uint32_t>(table.size());
+        auto head = freeHead.load(std::memory_order_acquire);
+        while (true) {
+            pinggy_uint32_t top = (pinggy_uint32_t)(head & 0xffffffffu);
+            if (top == 0)
+                return false;
+            auto next = slotAt(top - 1).nextFree.load(std::memory_order_relaxed);
+            uint64_t newHead = (((head >> 32) + 1) << 32) | next;
+            if (freeHead.compare_exchange_weak(head, newHead, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                index = top - 1;
+                return true;
+            }
+        }
+    }
 
-        pinggy_uint32_t newSize =
-            (oldSize == 0) ? 1024 : oldSize * 2;
+    pinggy_void_t
+    pushFree(pinggy_uint32_t index)
+    {
+        auto head = freeHead.load(std::memory_order_relaxed);
+        while (true) {
+            slotAt(index).nextFree.store((pinggy_uint32_t)(head & 0xffffffffu), std::memory_order_relaxed);
+            uint64_t newHead = (((head >> 32) + 1) << 32) | (index + 1);
+            if (freeHead.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed))
+                return;
+        }
+    }
 
-        table.resize(newSize);
+    bool
+    allocate(pinggy_uint32_t &index)
+    {
+        if (popFree(index))
+            return true;
 
-        for (pinggy_uint32_t i = oldSize; i < newSize; ++i)
-            freeList.push(i);
+        index = used.fetch_add(1, std::memory_order_relaxed);
+        if (index > REF_TABLE_INDEX_MASK) {
+            used.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        auto &chunk = chunks[index >> REF_TABLE_CHUNK_BITS];
+        if (!chunk.load(std::memory_order_acquire)) {
+            Slot *expected = nullptr;
+            auto newChunk = new Slot[REF_TABLE_CHUNK_SIZE];
+            if (!chunk.compare_exchange_strong(expected, newChunk, std::memory_order_acq_rel))
+                delete[] newChunk;
+        }
+        return true;
     }
 
 public:
     explicit
-    RefTable()
+    RefTable(): used(0), freeHead(0)
     {
-        grow();
+        for (auto &chunk : chunks)
+            chunk.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~RefTable()
+    {
+        for (auto &chunk : chunks)
+            delete[] chunk.load(std::memory_order_relaxed);
     }
 
     pinggy_ref_t
     GetRef(tVoidPtr ptr)
     {
-        std::lock_guard<std::mutex> guard(lock);
+        pinggy_uint32_t index;
+        if (!allocate(index))
+            return INVALID_PINGGY_REF;
 
-        if (freeList.empty())
-            grow();
+        auto &entry = slotAt(index);
+        entry.generation = (entry.generation + 1) & REF_TABLE_GENERATION_MASK;
+        if (entry.generation == 0)
+            entry.generation = 1;
+        entry.obj = ptr;
 
-        pinggy_ref_t ref = freeList.front();
-        freeList.pop();
-
-        table[ref] = ptr;
+        pinggy_ref_t ref = (entry.generation << REF_TABLE_INDEX_BITS) | index;
+        entry.ref.store(ref, std::memory_order_seq_cst);
 
         return ref;
     }
@@ -56,28 +154,36 @@ public:
     tVoidPtr
     GetObj(pinggy_ref_t ref)
     {
-        if (ref >= table.size())
+        auto entry = slotForRef(ref);
+        if (!entry)
             return nullptr;
 
-        auto &entry = table[ref];
+        tVoidPtr obj = nullptr;
+        entry->readers.fetch_add(1, std::memory_order_seq_cst);
+        if (entry->ref.load(std::memory_order_seq_cst) == ref)
+            obj = entry->obj;
+        entry->readers.fetch_sub(1, std::memory_order_release);
 
-        return entry;
+        return obj;
     }
 
     bool
     RemoveRef(pinggy_ref_t ref)
     {
-        std::lock_guard<std::mutex> guard(lock);
-
-        if (ref >= table.size())
+        auto entry = slotForRef(ref);
+        if (!entry)
             return false;
 
-        auto& entry = table[ref];
+        auto expected = ref;
+        if (!entry->ref.compare_exchange_strong(expected, INVALID_PINGGY_REF, std::memory_order_seq_cst))
+            return false;
 
-        entry.reset();
+        while (entry->readers.load(std::memory_order_seq_cst) != 0)
+            std::this_thread::yield();
 
-        freeList.push(ref);
+        entry->obj = nullptr;
+        pushFree(ref & REF_TABLE_INDEX_MASK);
 
         return true;
     }
-};
\ No newline at end of file
+};
@@ -15,6 +15,7 @@
  */
 
 #include "Sdk.hh"
+#include "SdkRuntime.hh"
 #ifndef __WINDOWS_OS__
 #include <poll/PinggyPollLinux.hh>
 #endif
@@ -23,9 +24,9 @@
 #include <net/UdpConnection.hh>
 #include <net/DummyConnection.hh>
 #include <net/SslNetworkConnection.hh>
+#include <algorithm>
 #include <thread>
 #include <utils/Json.hh>
-#include <utils/Semaphore.hh>
 #include <platform/Defer.hh>
 #include "SdkException.hh"
 
@@ -72,46 +73,36 @@ tString NOTIFICATION_FD = "NOTIFICATION_FD";
 #define PINGGY_LIFE_CYCLE_WRAPPER_FUNC
 #define PINGGY_ATTRIBUTE_FUNC
 
+#define KEEPALIVE_INTERVAL      (5*SECOND)
+#define KEEPALIVE_TIMEOUT       (4*SECOND)
+#define KEEPALIVE_MAX_MISSED    3 //consecutive regular keepalives
+
 //Rules:
 // 1. no private function should lock the lockAccess
 // 2. Every life cycle function should lock the lockAccess even before starting
 // 3. Every non-life cycle functions that needs to access session (direct or undirect)
-//    needs lockAccess (unless same thread and running)
-
-class ThreadLock : public pinggy::SharedObject
-{
-public:
-    ThreadLock(SdkPtr sdk):
-            sdk(sdk)
-    {
-        sdk->acquireAccessLock();
-    }
-
-    virtual
-    ~ThreadLock()
-    {
-        sdk->releaseAccessLock();
-    }
-
-    DefineMandatoryFileLocalClassFunctionsWOSuper(ThreadLock);
-
-private:
-    SdkPtr                  sdk;
-};
-DefineMakeSharedPtr(ThreadLock);
+//    runs as a command on the tunnel thread (see Post / Run)
 
 
 Sdk::Sdk(SDKConfigPtr config, SdkEventHandlerPtr _eventHandler):
             running(false),
             sdkConfig(config),
             eventHandler(_eventHandler),
-            semaphore(NewSemaphorePtr(1)),
-            lastKeepAliveTickReceived(0),
+            notificationFd(InValidSocket),
+            keepAliveTicksAnswered(0),
+            keepAlivesMissed(0),
             state(SdkState::Initial),
             reconnectCounter(0),
             usagesRunning(false),
             appHandlesNewChannel(false),
-            reconnectMode(false)
+            reconnectMode(false),
+            runtimeReactor(-1),
+            hostedByRuntime(false),
+            submittedToRuntime(false),
+            sessionStats(protocol::NewSessionStatsPtr()),
+            totalReconnects(0),
+            tlsHandshakes(0),
+            tlsSessionsResumed(0)
 {
     if (!config) {
         throw SdkException("Config not provided.");
@@ -121,27 +112,37 @@ Sdk::Sdk(SDKConfigPtr config, SdkEventHandlerPtr _eventHandler):
 Sdk::~Sdk()
 {
     cleanup();
+
+    // kept open until now, other threads may still be notifying
+    notificationFd = InValidSocket;
+    if (notificationConn) {
+        notificationConn->CloseConn();
+        notificationConn = nullptr;
+        _notificateMonitorConn->CloseConn();
+        _notificateMonitorConn = nullptr;
+    }
 }
 
 bool PINGGY_LIFE_CYCLE_WRAPPER_FUNC
 Sdk::Start(bool block)
 {
+    if (hostedByRuntime) {
+        auto hostRuntime = runtime.lock();
+        if (!hostRuntime) {
+            throw SdkException("The runtime of the tunnel is gone");
+        }
+        if (submittedToRuntime) {
+            throw SdkException("Tunnel already started");
+        }
+        submittedToRuntime = true;
+        return hostRuntime->AddTunnel(thisPtr, runtimeReactor);
+    }
+
     //==== Setup =========
     if (state == SdkState::Initial) // Make sure that SdkInitial is not set again
     {
         acquireAccessLock();
-
-        state = SdkState::Started;
-
-        sdkConfig = sdkConfig->clone();
-        sdkConfig->validate();
-
-        reconnectMode = sdkConfig->autoReconnect;
-        reconnectCounter = 0;
-
-        initPollController();
-        internalConnect();
-
+        setupTunnel();
         releaseAccessLock();
     }
 
@@ -158,23 +159,74 @@ Sdk::Start(bool block)
 bool PINGGY_ATTRIBUTE_FUNC
 Sdk::Stop()
 {
-    auto lock = LockIfDifferentThread();
-    if (state >= SdkState::Stopped)
-        return false;
+    return Run([this]() {
+        if (state >= SdkState::Stopped)
+            return false;
 
-    if (state >= SdkState::SessionInitiated && state < SdkState::Stopped) {
-        if (session) {
-            session->End("Connection close");
+        if (state >= SdkState::SessionInitiated && state < SdkState::Stopped) {
+            if (session) {
+                session->End("Connection close");
+            }
         }
-    }
 
-    disconnectionReason = "Stopped by user";
-    state = SdkState::Stopped;
-    return true;
+        disconnectionReason = "Stopped by user";
+        state = SdkState::Stopped;
+        return true;
+    });
 }
 
 bool PINGGY_LIFE_CYCLE_FUNC
 Sdk::ResumeTunnel(tInt32 timeout)
+{
+    if (hostedByRuntime) {
+        throw SdkException("The tunnel is served by its runtime");
+    }
+    return resumeTunnel(timeout);
+}
+
+void
+Sdk::SetRuntime(SdkRuntimePtr runtime, tInt32 reactor)
+{
+    if (state != SdkState::Initial) {
+        throw SdkException("Tunnel already started");
+    }
+    this->runtime = runtime;
+    runtimeReactor = reactor;
+    hostedByRuntime = runtime != nullptr;
+}
+
+bool PINGGY_LIFE_CYCLE_FUNC
+Sdk::ServeOnce(common::PollControllerPtr &poll, tInt32 &timeout)
+{
+    poll = nullptr;
+    timeout = -1;
+
+    if (state == SdkState::Initial) {
+        acquireAccessLock();
+        setupTunnel();
+        releaseAccessLock();
+    }
+
+    if (!resumeTunnel(0) || state == SdkState::Ended)
+        return false;
+
+    acquireAccessLock(true);
+    DEFER({releaseAccessLock();});
+
+    if (state == SdkState::Stopped || state == SdkState::ReconnectInitiated) {
+        // the blocking loop would resume right away, so should the runtime
+        timeout = 0;
+    } else if (pollController && pollController->HaveFutureTasks()) {
+        timeout = (tInt32)(pollController->GetNextTaskTimeout() / MILLISECOND);
+    }
+
+    poll = pollController;
+
+    return true;
+}
+
+bool
+Sdk::resumeTunnel(tInt32 timeout)
 {
     if (state == SdkState::Initial) {
         throw SdkException("Tunnel not started yet");
@@ -206,6 +258,7 @@ Sdk::ResumeTunnel(tInt32 timeout)
 
         cleanupForReconnection();
         reconnectCounter += 1;
+        totalReconnects.fetch_add(1, std::memory_order_relaxed);
 
         return true;
     }
@@ -243,25 +296,67 @@ Sdk::GetSdkEventHandler()
     return eventHandler;
 }
 
-// This function wait until running thread blocks
-ThreadLockPtr
-Sdk::LockIfDifferentThread()
+SdkStats PINGGY_ATTRIBUTE_FUNC
+Sdk::GetStats()
 {
-    auto curThreadId = std::this_thread::get_id();
-    if (curThreadId == runningThreadId) { //it will never be same unless they are really same. We do not change running thread without lock
-        LOGD("Same thread. not locking.", curThreadId, runningThreadId);
-        return nullptr;
+    SdkStats stats;
+    stats.bytesIn                   = sessionStats->bytesIn.load(std::memory_order_relaxed);
+    stats.bytesOut                  = sessionStats->bytesOut.load(std::memory_order_relaxed);
+    stats.activeChannels            = sessionStats->activeChannels.load(std::memory_order_relaxed);
+    stats.totalChannels             = sessionStats->totalChannels.load(std::memory_order_relaxed);
+    stats.channelSetupLatencyP50    = sessionStats->channelSetupLatency.GetPercentile(50);
+    stats.channelSetupLatencyP90    = sessionStats->channelSetupLatency.GetPercentile(90);
+    stats.channelSetupLatencyP99    = sessionStats->channelSetupLatency.GetPercentile(99);
+    stats.keepAliveRtt              = sessionStats->keepAliveRtt.load(std::memory_order_relaxed);
+    stats.keepAliveSrtt             = sessionStats->keepAliveSrtt.load(std::memory_order_relaxed);
+    stats.keepAliveRttVar           = sessionStats->keepAliveRttVar.load(std::memory_order_relaxed);
+    stats.keepAliveRttMin           = sessionStats->keepAliveRttMin.load(std::memory_order_relaxed);
+    stats.keepAliveRttMax           = sessionStats->keepAliveRttMax.load(std::memory_order_relaxed);
+    stats.keepAliveRttP50           = sessionStats->keepAliveRttHistogram.GetPercentile(50);
+    stats.keepAliveRttP90           = sessionStats->keepAliveRttHistogram.GetPercentile(90);
+    stats.keepAliveRttP99           = sessionStats->keepAliveRttHistogram.GetPercentile(99);
+    stats.keepAliveSamples          = sessionStats->keepAliveSamples.load(std::memory_order_relaxed);
+    stats.sendQueueDepth            = sessionStats->sendQueueDepth.load(std::memory_order_relaxed);
+    stats.reconnects                = totalReconnects.load(std::memory_order_relaxed);
+    stats.tlsHandshakes             = tlsHandshakes.load(std::memory_order_relaxed);
+    stats.tlsSessionsResumed        = tlsSessionsResumed.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(statsLock);
+    for (auto &entry : forwardingCounters) {
+        auto counter = entry.second;
+        SdkForwardingStats fwdStats;
+        fwdStats.forwardingId       = entry.first;
+        fwdStats.bytesToLocal       = counter->bytesToConnection.load(std::memory_order_relaxed);
+        fwdStats.bytesFromLocal     = counter->bytesToChannel.load(std::memory_order_relaxed);
+        fwdStats.activeChannels     = counter->activeChannels.load(std::memory_order_relaxed);
+        fwdStats.totalChannels      = counter->totalChannels.load(std::memory_order_relaxed);
+        fwdStats.rejectedChannels   = counter->rejectedChannels.load(std::memory_order_relaxed);
+        stats.forwardings.push_back(fwdStats);
+    }
+    return stats;
+}
+
+void
+Sdk::enqueueCommand(CommandQueue::tCommand command)
+{
+    if (std::this_thread::get_id() == runningThreadId) { //it will never be same unless they are really same. We do not change running thread without lock
+        command();
+        return;
     }
-    semaphore->Wait();
-    sdk::ThreadLockPtr threadLock = nullptr;
-    if (notificationConn) {
-        notificationConn->Write(NewRawDataPtr(tString("a")));
-        threadLock = NewThreadLockPtr(new ThreadLock(thisPtr));
-    } else {
-        throw SdkException("The tunnel is not ready now");
+
+    if (commandQueue.Push(command)) {
+        sock_t fd = notificationFd;
+        if (IsValidSocket(fd) && app_send(fd, "a", 1, 0) <= 0) {
+            LOGE("Could not notify the tunnel thread");
+        }
+    }
+
+    // Nothing polls the tunnel before it starts or after it ends.
+    auto curState = state.load();
+    if (curState == SdkState::Initial || curState == SdkState::Ended) {
+        std::lock_guard<std::mutex> lock(lockAccess);
+        runCommands();
     }
-    semaphore->Notify();
-    return threadLock;
 }
 
 tString PINGGY_ATTRIBUTE_FUNC
@@ -275,25 +370,26 @@ Sdk::StartWebDebugging(tString addr)
         throw WebDebuggerException("You are not logged in. How did you managed to come here?" );
     }
 
-    auto lock = LockIfDifferentThread();
-    if (!webDebugListener) {
-        auto bindUrl = NewUrlPtr(addr);
-
-        webDebugListener = net::NewConnectionListenerImplPtr(bindUrl->GetRawHost(), bindUrl->GetPort());
+    return Run([this, addr]() -> tString {
         if (!webDebugListener) {
-            throw WebDebuggerException("Webdebug listener could not listen. ignoring");
-        }
+            auto bindUrl = NewUrlPtr(addr);
 
-        if (!webDebugListener->StartListening()) {
-            webDebugListener = nullptr; //we don't have to close as it will be closed automatically
-            throw WebDebuggerException("Something wrong with the webdebug listener.");
-        }
+            webDebugListener = net::NewConnectionListenerImplPtr(bindUrl->GetRawHost(), bindUrl->GetPort());
+            if (!webDebugListener) {
+                throw WebDebuggerException("Webdebug listener could not listen. ignoring");
+            }
 
-        webDebugListener->RegisterListenerHandler(pollController, thisPtr, 1);
-    }
+            if (!webDebugListener->StartListening()) {
+                webDebugListener = nullptr; //we don't have to close as it will be closed automatically
+                throw WebDebuggerException("Something wrong with the webdebug listener.");
+            }
+
+            webDebugListener->RegisterListenerHandler(pollController, thisPtr, 1);
+        }
 
-    auto bindAddr = webDebugListener->GetListeningAddress();
-    return bindAddr ? bindAddr->ToString() : "";
+        auto bindAddr = webDebugListener->GetListeningAddress();
+        return bindAddr ? bindAddr->ToString() : "";
+    });
 }
 
 void PINGGY_ATTRIBUTE_FUNC
@@ -309,14 +405,15 @@ Sdk::RequestAdditionalForwarding(tString forwardingType, tString bindingUrl, tSt
 
     auto forwarding = SDKConfig::parseForwarding(forwardingType, bindingUrl, forwardTo);
 
-    auto lock = LockIfDifferentThread();
-    if (state < SdkState::ForwardingSucceeded) {
-        throw RemoteForwardingException("primary reverse forwarding for this tunnel");
-    }
+    Run([this, forwarding]() {
+        if (state < SdkState::ForwardingSucceeded) {
+            throw RemoteForwardingException("primary reverse forwarding for this tunnel");
+        }
 
-    additionalForwardings.push_back(forwarding);
+        additionalForwardings.push_back(forwarding);
 
-    internalRequestAdditionalRemoteForwarding(forwarding);
+        internalRequestAdditionalRemoteForwarding(forwarding);
+    });
 }
 
 void
@@ -332,14 +429,15 @@ Sdk::RequestAdditionalForwarding(tString forwardTo)
 
     auto forwarding = SDKConfig::parseForwarding(forwardTo);
 
-    auto lock = LockIfDifferentThread();
-    if (state < SdkState::ForwardingSucceeded) {
-        throw RemoteForwardingException("primary reverse forwarding for this tunnel");
-    }
+    Run([this, forwarding]() {
+        if (state < SdkState::ForwardingSucceeded) {
+            throw RemoteForwardingException("primary reverse forwarding for this tunnel");
+        }
 
-    additionalForwardings.push_back(forwarding);
+        additionalForwardings.push_back(forwarding);
 
-    internalRequestAdditionalRemoteForwarding(forwarding);
+        internalRequestAdditionalRemoteForwarding(forwarding);
+    });
 }
 
 SdkState
@@ -450,6 +548,7 @@ Sdk::HandleSessionRemoteForwardingSucceeded(protocol::tReqId reqId, tForwardingI
         }
 
         sdkForwardings[forwardingId] = elem->second;
+        startUpstreamPool(forwardingId, elem->second);
 
         pendingRemoteForwardingRequestMap.erase(elem);
 
@@ -470,7 +569,9 @@ Sdk::HandleSessionRemoteForwardingSucceeded(protocol::tReqId reqId, tForwardingI
 
         LOGD("Primary forwarding done");
 
-        keepAliveTask = pollController->SetInterval(5 * SECOND, thisPtr, &Sdk::sendKeepAlive);
+        keepAliveTicksAnswered = 0; //ticks start over with every session
+        keepAlivesMissed = 0;
+        keepAliveTask = pollController->SetInterval(KEEPALIVE_INTERVAL, thisPtr, &Sdk::sendKeepAlive);
 
         for (auto forwarding : additionalForwardings) { // yes we are starting additional forwarding right here.
             forwarding->newFlag = false;
@@ -502,6 +603,7 @@ Sdk::HandleSessionRemoteForwardingSucceeded(protocol::tReqId reqId, tForwardingI
     }
 
     sdkForwardings[forwardingId] = forwarding;
+    startUpstreamPool(forwardingId, forwarding);
 
     updateForwardMap(remoteForwardings);
 
@@ -578,9 +680,20 @@ Sdk::HandleSessionNewChannelRequest(protocol::ChannelPtr channel)
                 return;
         }
 
+        auto pool = upstreamPools.find(forwardingId);
+        if (pool != upstreamPools.end()) {
+            auto netConn = pool->second->Take();
+            if (netConn) {
+                forwardChannel(channel, netConn);
+                return;
+            }
+        }
+
         try {
             auto netConnImpl = net::NewNetworkConnectionImplPtr(toHost, std::to_string(toPort), false);
             netConnImpl->SetPollController(pollController);
+            netConnImpl->SetResolver(resolver);
+            netConnImpl->ApplySocketTuning(sdkConfig->upstreamSocketTuning);
             netConnImpl->Connect(thisPtr, channel);
             return; //we will handle this in different place
         } catch(...) {
@@ -610,7 +723,7 @@ Sdk::HandleSessionNewChannelRequest(protocol::ChannelPtr channel)
 
         channel->Accept();
         netConn->SetPollController(pollController);
-        auto channelForward = protocol::NewChannelConnectionForwarderPtr(channel, netConn, nullptr);
+        auto channelForward = protocol::NewChannelConnectionForwarderPtr(channel, netConn, forwardingCounter(forwardingId));
         channelForward->Start();
     }
 }
@@ -619,7 +732,12 @@ void
 Sdk::HandleSessionKeepAliveResponseReceived(tUint64 tick)
 {
     LOGT("Keepalive response recvd: tick: ", tick);
-    lastKeepAliveTickReceived = tick;
+    keepAliveTicksAnswered = std::max(keepAliveTicksAnswered, tick + 1);
+
+    if (    sdkConfig->keepAliveProbeInterval && keepAliveTask && !keepAliveProbeTask
+         && sessionStats->IsKeepAliveRttUnstable()) {
+        keepAliveProbeTask = pollController->SetTimeout(sdkConfig->keepAliveProbeInterval, thisPtr, &Sdk::sendKeepAliveProbe);
+    }
 }
 
 void
@@ -660,6 +778,20 @@ Sdk::HandleSessionError(tUint32 errorNo, tString what, tBool recoverable)
         eventHandler->OnHandleError(errorNo, what, recoverable);
 }
 
+void
+Sdk::HandleSessionStripesOffered(tUint8 maxStripes)
+{
+    LOGD("Server offered stripes: ", (tUint32)maxStripes);
+    replenishStripes();
+}
+
+void
+Sdk::HandleSessionStripeFailed(tUint8 stripeId)
+{
+    LOGD("Stripe failed: ", (tUint32)stripeId);
+    pollController->SetTimeout(sdkConfig->autoReconnectInterval * SECOND, thisPtr, &Sdk::replenishStripes);
+}
+
 void
 Sdk::HandleSessionUsages(ClientSpecificUsagesPtr usages)
 {
@@ -715,10 +847,7 @@ Sdk::HandleFDReadWTag(PollableFDPtr pfd, tString tag)
             netConn->CloseConn();
             return len;
         }
-        releaseAccessLock();
-        semaphore->Wait();
-        acquireAccessLock(true);
-        semaphore->Notify();
+        runCommands();
         return len;
     }
     return 0;
@@ -750,10 +879,7 @@ Sdk::HandleConnected(net::NetworkConnectionImplPtr netConn)
         netConn->CloseConn();
         return 0;
     }
-    channel->Accept();
-
-    auto channelForward = protocol::NewChannelConnectionForwarderPtr(channel, netConn, nullptr);
-    channelForward->Start();
+    forwardChannel(channel, netConn);
     return 0;
 }
 
@@ -821,44 +947,170 @@ Sdk::internalConnect()
 
     state = SdkState::Connecting;
 
-    //TODO Change both the connect to non-blocking
+    initiateNotificationChannel(); //other threads need to reach us while connecting
+
+    SdkWPtr weakSdk = thisPtr;
+    baseConnector = NewServerConnectorPtr(sdkConfig, pollController, BASE_CERTIFICATE,
+                        [weakSdk](net::NetworkConnectionPtr netConn, tString error) {
+                            auto sdk = weakSdk.lock();
+                            if (sdk)
+                                sdk->baseConnectionReady(netConn, error);
+                        });
+    baseConnector->SetResolver(resolver);
     try {
-        auto serverAddress = sdkConfig->serverAddress;
-        baseConnection = net::NewNetworkConnectionImplPtr(serverAddress->GetRawHost(), serverAddress->GetPortStr());
-
-        if (sdkConfig->ssl){
-            auto sslConnection = net::NewSslNetworkConnectionPtr(baseConnection, sdkConfig->sniServerName);
-            sslConnection->SetBaseCertificate(BASE_CERTIFICATE);
-            sslConnection->Connect();
-            baseConnection = sslConnection;
-        }
+        baseConnector->Start();
     } catch (const std::exception &e) {
-        baseConnection = nullptr;
+        baseConnector->Cancel();
+        baseConnector = nullptr;
         LOGE("Exception occurred: ", e.what());
         reconnectOrStopLoop(e.what());
+    }
+}
+
+void
+Sdk::baseConnectionReady(net::NetworkConnectionPtr netConn, tString error)
+{
+    baseConnector = nullptr;
+
+    if (state != SdkState::Connecting) {
+        if (netConn)
+            netConn->CloseConn();
         return;
     }
 
-    if (!baseConnection) {
-        reconnectOrStopLoop("Unable to connect");
-        return; //unused code
+    if (!netConn) {
+        LOGE("Could not connect: ", error);
+        reconnectOrStopLoop(error.empty() ? "Unable to connect" : error);
+        return;
     }
 
-    state = SdkState::Connected;
+    countTlsHandshake(netConn);
 
-    baseConnection->SetPollController(pollController);
+    baseConnection = netConn;
+    state = SdkState::Connected;
 
-    session = protocol::NewSessionPtr(baseConnection);
+    session = protocol::NewSessionPtr(baseConnection, pollController);
+    session->SetStats(sessionStats);
     session->SetEnablePinggyValueMode(true);
-    session->SetSessionVersion(PINGGY_SESSION_VERSION_1_02);
+    session->SetSessionVersion(PINGGY_SESSION_VERSION_1_05);
     session->Start(thisPtr);
     LOGT("Session Started");
 
-    initiateNotificationChannel();
-
     state = SdkState::SessionInitiating;
 }
 
+void
+Sdk::cancelServerConnectors()
+{
+    if (baseConnector) {
+        baseConnector->Cancel();
+        baseConnector = nullptr;
+    }
+    for (auto connector : stripeConnectors)
+        connector->Cancel();
+    stripeConnectors.clear();
+}
+
+void
+Sdk::startUpstreamPool(tForwardingId forwardingId, SdkForwardingPtr forwarding)
+{
+    if (sdkConfig->upstreamPoolSize == 0 || forwarding->mode == TunnelMode::UDP)
+        return;
+
+    auto pool = NewUpstreamPoolPtr(forwarding->fwdToHost, std::to_string(forwarding->fwdToPort),
+                                   pollController, resolver, sdkConfig->upstreamPoolSize);
+    upstreamPools[forwardingId] = pool;
+    pool->SetSocketTuning(sdkConfig->upstreamSocketTuning);
+    pool->Start();
+}
+
+void
+Sdk::stopUpstreamPools()
+{
+    for (auto &pool : upstreamPools)
+        pool.second->Stop();
+    upstreamPools.clear();
+}
+
+void
+Sdk::forwardChannel(protocol::ChannelPtr channel, net::NetworkConnectionPtr netConn)
+{
+    channel->Accept();
+
+    auto channelForward = protocol::NewChannelConnectionForwarderPtr(channel, netConn, forwardingCounter(channel->GetForwardingId()));
+    channelForward->Start();
+}
+
+protocol::ForwardingCounterPtr
+Sdk::forwardingCounter(tForwardingId forwardingId)
+{
+    std::lock_guard<std::mutex> lock(statsLock);
+    auto &counter = forwardingCounters[forwardingId];
+    if (!counter)
+        counter = protocol::NewForwardingCounterPtr();
+    return counter;
+}
+
+void
+Sdk::replenishStripes()
+{
+    if (!session || state < SdkState::Authenticated || state >= SdkState::Stopped)
+        return;
+
+    if (!session->IsStripingAvailable())
+        return;
+
+    tUint8 wanted = std::min(sdkConfig->connectionStripes, session->GetMaxStripes());
+    SdkWPtr weakSdk = thisPtr;
+    while (session->GetStripeCount() + stripeConnectors.size() < wanted) {
+        auto connector = NewServerConnectorPtr(sdkConfig, pollController, BASE_CERTIFICATE,
+                            [weakSdk](net::NetworkConnectionPtr netConn, tString error) {
+                                auto sdk = weakSdk.lock();
+                                if (sdk)
+                                    sdk->stripeConnectionReady(netConn, error);
+                            });
+        connector->SetResolver(resolver);
+        try {
+            connector->Start();
+        } catch (const std::exception &e) {
+            connector->Cancel();
+            LOGE("Could not open stripe: ", e.what());
+            break;
+        }
+        if (!connector->IsDone())
+            stripeConnectors.push_back(connector);
+    }
+}
+
+void
+Sdk::stripeConnectionReady(net::NetworkConnectionPtr netConn, tString error)
+{
+    stripeConnectors.erase(std::remove_if(stripeConnectors.begin(), stripeConnectors.end(),
+                                [](ServerConnectorPtr c) { return c->IsDone(); }),
+                           stripeConnectors.end());
+
+    if (!netConn) {
+        LOGE("Could not open stripe: ", error);
+        return;
+    }
+
+    countTlsHandshake(netConn);
+
+    if (!session || state >= SdkState::Stopped || !session->AddStripe(netConn))
+        netConn->CloseConn();
+}
+
+void
+Sdk::countTlsHandshake(net::NetworkConnectionPtr netConn)
+{
+    auto sslConn = netConn->DynamicPointerCast<net::SslNetworkConnection>();
+    if (!sslConn)
+        return;
+    tlsHandshakes.fetch_add(1, std::memory_order_relaxed);
+    if (sslConn->IsSessionResumed())
+        tlsSessionsResumed.fetch_add(1, std::memory_order_relaxed);
+}
+
 bool
 Sdk::startPollingInCurrentThread()
 {
@@ -867,6 +1119,21 @@ Sdk::startPollingInCurrentThread()
     return true;
 }
 
+void
+Sdk::setupTunnel()
+{
+    state = SdkState::Started;
+
+    sdkConfig = sdkConfig->clone();
+    sdkConfig->validate();
+
+    reconnectMode = sdkConfig->autoReconnect;
+    reconnectCounter = 0;
+
+    initPollController();
+    internalConnect();
+}
+
 void
 Sdk::initiateNotificationChannel()
 {
@@ -878,7 +1145,15 @@ Sdk::initiateNotificationChannel()
         netConn->SetBlocking(false);
         netConn->SetPollController(pollController)->RegisterFDEvenHandler(thisPtr, NOTIFICATION_FD);
         _notificateMonitorConn = netConn;
+        notificationFd = notificationConn->GetFd();
     }
+    runCommands(); //posted before there was anything to notify
+}
+
+void
+Sdk::runCommands()
+{
+    commandQueue.RunAll();
 }
 
 void
@@ -896,10 +1171,10 @@ Sdk::cleanup()
     if (state == SdkState::Ended)
         return;
 
-    if (keepAliveTask) {
-        keepAliveTask->DisArm();
-        keepAliveTask = nullptr;
-    }
+    stopKeepAlive();
+
+    cancelServerConnectors();
+    stopUpstreamPools();
 
     if (session) {
         session->Cleanup();
@@ -908,12 +1183,8 @@ Sdk::cleanup()
 
     stopWebDebugger();
 
-    if (notificationConn) {
-        notificationConn->CloseConn();
-        notificationConn = nullptr;
+    if (_notificateMonitorConn) {
         _notificateMonitorConn->DeregisterFDEvenHandler();
-        _notificateMonitorConn->CloseConn();
-        _notificateMonitorConn = nullptr;
     }
 
     if (baseConnection) {
@@ -922,6 +1193,11 @@ Sdk::cleanup()
         baseConnection = nullptr;
     }
 
+    if (resolver) {
+        resolver->Stop();
+        resolver = nullptr;
+    }
+
     if (pollController) {
         pollController->StopPolling();
         pollController->DeregisterAllHandlers();
@@ -936,6 +1212,8 @@ Sdk::cleanup()
     }
 
     state = SdkState::Ended;
+
+    runCommands(); //whatever was posted before the end
 }
 
 void
@@ -943,7 +1221,7 @@ Sdk::sendKeepAlive()
 {
     if (session) {
         auto tick = session->SendKeepAlive();
-        pollController->SetTimeout(4*SECOND, thisPtr, &Sdk::keepAliveTimeout, tick);
+        pollController->SetTimeout(KEEPALIVE_TIMEOUT, thisPtr, &Sdk::keepAliveTimeout, tick);
         LOGT("Sending keepalive");
     }
 }
@@ -951,7 +1229,15 @@ Sdk::sendKeepAlive()
 void
 Sdk::keepAliveTimeout(tUint64 tick)
 {
-    if (tick > (lastKeepAliveTickReceived+2) && !session->IsThereIncomingActivities()) {
+    if (!session)
+        return;
+
+    if (keepAliveTicksAnswered > tick)
+        keepAlivesMissed = 0;
+    else
+        keepAlivesMissed += 1;
+
+    if (keepAlivesMissed >= KEEPALIVE_MAX_MISSED && !session->IsThereIncomingActivities()) {
         LOGI("Connection probably gone");
         releaseBaseConnection();
         lastError = "Tunnel seems unresponsive.";
@@ -962,6 +1248,34 @@ Sdk::keepAliveTimeout(tUint64 tick)
     }
 }
 
+/*
+ * Extra keepalive sent while the rtt is unstable, only to get more rtt
+ * samples. It has no timeout, so it does not count towards declaring the
+ * connection dead. The response schedules the next one if still needed.
+ */
+void
+Sdk::sendKeepAliveProbe()
+{
+    keepAliveProbeTask = nullptr;
+    if (session && keepAliveTask) {
+        session->SendKeepAlive();
+        LOGT("Sending keepalive probe");
+    }
+}
+
+void
+Sdk::stopKeepAlive()
+{
+    if (keepAliveTask) {
+        keepAliveTask->DisArm();
+        keepAliveTask = nullptr;
+    }
+    if (keepAliveProbeTask) {
+        keepAliveProbeTask->DisArm();
+        keepAliveProbeTask = nullptr;
+    }
+}
+
 void
 Sdk::stopWebDebugger()
 {
@@ -977,11 +1291,15 @@ Sdk::cleanupForReconnection()
 {
     if (_notificateMonitorConn)
         _notificateMonitorConn->SetPollController(nullptr);
+    cancelServerConnectors();
+    stopUpstreamPools();
     if (session) {
         session->Cleanup();
         session = nullptr;
     }
     baseConnection = nullptr;
+    if (resolver) //bound to the old poll controller
+        resolver->Stop();
     pollController->DeregisterAllHandlers();
     pollController = nullptr;
     initPollController();
@@ -1003,6 +1321,7 @@ Sdk::initPollController()
 #endif
 
     this->pollController = pollController;
+    resolver = net::NewAsyncResolverPtr(pollController);
 }
 
 bool
@@ -1124,10 +1443,7 @@ Sdk::initiateReconnection()
 void
 Sdk::releaseBaseConnection()
 {
-    if (keepAliveTask) {
-        keepAliveTask->DisArm();
-        keepAliveTask = nullptr;
-    }
+    stopKeepAlive();
 
     if (pollController && baseConnection) { //TODO I don't like this. However this best for the time being
         baseConnection->DeregisterFDEvenHandler();
@@ -20,11 +20,16 @@
 #include <net/ConnectionListener.hh>
 #include <Session.hh>
 #include <poll/PinggyPoll.hh>
+#include <atomic>
+#include <future>
 #include <mutex>
 #include <thread>
-#include <utils/Semaphore.hh>
+#include "CommandQueue.hh"
+#include <ChannelConnectionForwarder.hh>
 #include "SdkChannelWraper.hh"
 #include "SdkConfig.hh"
+#include "ServerConnector.hh"
+#include "UpstreamPool.hh"
 
 namespace sdk
 {
@@ -107,7 +112,48 @@ public:
 };
 DeclareSharedPtr(SdkEventHandler);
 
-DeclareClassWithSharedPtr(ThreadLock);
+struct SdkForwardingStats
+{
+    tForwardingId               forwardingId;
+    tUint64                     bytesToLocal; //visitor to local server
+    tUint64                     bytesFromLocal; //local server to visitor
+    tUint32                     activeChannels;
+    tUint64                     totalChannels;
+    tUint64                     rejectedChannels;
+};
+
+/*
+ * Point in time copy of the tunnel counters. Byte counters are channel
+ * payload since the tunnel started, reconnections included. Latencies are
+ * in microseconds.
+ */
+struct SdkStats
+{
+    tUint64                     bytesIn = 0;
+    tUint64                     bytesOut = 0;
+    tUint32                     activeChannels = 0;
+    tUint64                     totalChannels = 0;
+    tUint64                     channelSetupLatencyP50 = 0;
+    tUint64                     channelSetupLatencyP90 = 0;
+    tUint64                     channelSetupLatencyP99 = 0;
+    tUint64                     keepAliveRtt = 0; //latest sample
+    tUint64                     keepAliveSrtt = 0; //smoothed
+    tUint64                     keepAliveRttVar = 0; //mean deviation
+    tUint64                     keepAliveRttMin = 0;
+    tUint64                     keepAliveRttMax = 0;
+    tUint64                     keepAliveRttP50 = 0;
+    tUint64                     keepAliveRttP90 = 0;
+    tUint64                     keepAliveRttP99 = 0;
+    tUint64                     keepAliveSamples = 0;
+    tUint32                     sendQueueDepth = 0;
+    tUint32                     reconnects = 0;
+    tUint32                     tlsHandshakes = 0; //base and stripe connections
+    tUint32                     tlsSessionsResumed = 0; //of those, resumed from a cached session
+    std::vector<SdkForwardingStats>
+                                forwardings;
+};
+
+DeclareClassWithSharedPtr(SdkRuntime);
 
 class Sdk:
         virtual public protocol::SessionEventHandler,
@@ -131,6 +177,20 @@ public:
     bool
     ResumeTunnel(tInt32 timeout = -1);
 
+    // Hosts the tunnel on a reactor thread of the runtime instead of the
+    // thread calling Start. Start then hands the tunnel to the runtime and
+    // returns, ResumeTunnel must not be called. reactor pins the tunnel to
+    // one reactor, negative means round robin.
+    void
+    SetRuntime(SdkRuntimePtr runtime, tInt32 reactor = -1);
+
+    // Used by the runtime only. Serves whatever is pending without blocking
+    // and reports the current poll controller, whose fd is to be waited on,
+    // and the time until its next timer in ms (-1 for none). Returns false
+    // once the tunnel has ended.
+    bool
+    ServeOnce(common::PollControllerPtr &poll, tInt32 &timeout);
+
     bool
     IsAuthenticated()           {return state >= SdkState::Authenticated;}
 
@@ -143,8 +203,22 @@ public:
     SdkEventHandlerPtr
     GetSdkEventHandler();
 
-    ThreadLockPtr
-    LockIfDifferentThread();
+    // Safe to call from any thread, it does not wait for the tunnel thread.
+    SdkStats
+    GetStats();
+
+    // Runs fn on the tunnel thread during its next poll iteration and
+    // returns without waiting. The future carries the result or the
+    // exception of fn. Called from the tunnel thread, fn runs right away.
+    template<typename Fn>
+    auto
+    Post(Fn fn) -> std::future<decltype(fn())>;
+
+    // Blocking wrapper around Post.
+    template<typename Fn>
+    auto
+    Run(Fn fn) -> decltype(fn())
+                                { return Post(fn).get(); }
 
     tString
     StartWebDebugging(tString addr);
@@ -217,6 +291,12 @@ public:
     virtual void
     HandleSessionUsages(ClientSpecificUsagesPtr usages) override;
 
+    virtual void
+    HandleSessionStripesOffered(tUint8 maxStripes) override;
+
+    virtual void
+    HandleSessionStripeFailed(tUint8 stripeId) override;
+
 
 //net::ConnectionListenerHandler
     virtual void
@@ -273,9 +353,36 @@ private:
     void
     internalConnect();
 
+    void
+    baseConnectionReady(net::NetworkConnectionPtr netConn, tString error);
+
+    void
+    cancelServerConnectors();
+
+    void
+    replenishStripes();
+
+    void
+    stripeConnectionReady(net::NetworkConnectionPtr netConn, tString error);
+
+    void
+    countTlsHandshake(net::NetworkConnectionPtr netConn);
+
     bool
     startPollingInCurrentThread();
 
+    void
+    setupTunnel();
+
+    void
+    enqueueCommand(CommandQueue::tCommand command);
+
+    void
+    runCommands();
+
+    bool
+    resumeTunnel(tInt32 timeout);
+
     void
     initiateNotificationChannel();
 
@@ -291,6 +398,12 @@ private:
     void
     keepAliveTimeout(tUint64 tick);
 
+    void
+    sendKeepAliveProbe();
+
+    void
+    stopKeepAlive();
+
     void
     stopWebDebugger();
 
@@ -333,8 +446,24 @@ private:
     void
     releaseBaseConnection();
 
+    void
+    startUpstreamPool(tForwardingId forwardingId, SdkForwardingPtr forwarding);
+
+    void
+    stopUpstreamPools();
+
+    void
+    forwardChannel(protocol::ChannelPtr channel, net::NetworkConnectionPtr netConn);
+
+    protocol::ForwardingCounterPtr
+    forwardingCounter(tForwardingId forwardingId);
+
     net::NetworkConnectionPtr   baseConnection;
+    ServerConnectorPtr          baseConnector;
+    std::vector<ServerConnectorPtr>
+                                stripeConnectors;
     common::PollControllerPtr   pollController;
+    net::AsyncResolverPtr       resolver;
     protocol::SessionPtr        session;
     bool                        running;
 
@@ -346,18 +475,21 @@ private:
     net::ConnectionListenerPtr  webDebugListener;
     SpecialPortConfigPtr        portConfig;
 
-    std::thread::id             runningThreadId;
+    std::atomic<std::thread::id>
+                                runningThreadId;
 
-    //Innder lock would be always locked by the tunnel
-    //To access something, first lock the outer lock, send the notification then try the inner lock
+    //Held by the thread polling the tunnel. Other threads do not take it,
+    //they post commands which the polling thread runs.
     std::mutex                  lockAccess;
     std::mutex                  reconnectLock; //we cannot use lock access as it will be used somewhere else
-    SemaphorePtr                semaphore;
+    CommandQueue                commandQueue;
+    std::atomic<sock_t>         notificationFd;
     net::NetworkConnectionPtr   notificationConn;
     net::NetworkConnectionPtr   _notificateMonitorConn;
 
-    tUint64                     lastKeepAliveTickReceived;
-    SdkState                    state;
+    tUint64                     keepAliveTicksAnswered; //latest answered tick + 1, 0 for none
+    tUint16                     keepAlivesMissed; //consecutive regular keepalives without response
+    std::atomic<SdkState>       state;
 
     std::map<protocol::tReqId, SdkForwardingPtr> // pendingReqId [remote binding address to localBinding address]
                                 pendingAdditionalRemoteForwardingMap;
@@ -365,8 +497,11 @@ private:
                                 pendingRemoteForwardingRequestMap;
     std::map<tForwardingId, SdkForwardingPtr>
                                 sdkForwardings;
+    std::map<tForwardingId, UpstreamPoolPtr>
+                                upstreamPools;
 
     common::PollableTaskPtr     keepAliveTask;
+    common::PollableTaskPtr     keepAliveProbeTask;
     tInt16                      reconnectCounter;
 
     bool                        usagesRunning;
@@ -381,10 +516,31 @@ private:
 
     tString                     disconnectionReason;
 
-    friend class ThreadLock;
+    SdkRuntimeWPtr              runtime;
+    tInt32                      runtimeReactor;
+    bool                        hostedByRuntime;
+    bool                        submittedToRuntime;
+
+    protocol::SessionStatsPtr   sessionStats; //shared by every session of the tunnel
+    std::atomic<tUint32>        totalReconnects;
+    std::atomic<tUint32>        tlsHandshakes;
+    std::atomic<tUint32>        tlsSessionsResumed;
+    std::mutex                  statsLock; //forwardingCounters only
+    std::map<tForwardingId, protocol::ForwardingCounterPtr>
+                                forwardingCounters;
 };
 DefineMakeSharedPtr(Sdk);
 
+template<typename Fn>
+auto
+Sdk::Post(Fn fn) -> std::future<decltype(fn())>
+{
+    auto task = std::make_shared<std::packaged_task<decltype(fn())()>>(fn);
+    auto future = task->get_future();
+    enqueueCommand([task]() { (*task)(); });
+    return future;
+}
+
 } // namespace sdk
 
 
@@ -31,45 +31,102 @@ bool
 SdkChannelWraper::Accept()
 {
     responded = true;
-    auto var = sdk->LockIfDifferentThread();
-    return channel->Accept();
+    return sdk->Run([&]() { return channel->Accept(); });
 }
 
 bool
 SdkChannelWraper::Reject(tString reason)
 {
     responded = true;
-    auto var = sdk->LockIfDifferentThread();
-    return channel->Reject(reason);
+    return sdk->Run([&]() { return channel->Reject(reason); });
 }
 
 bool
 SdkChannelWraper::Connect()
 {
     responded = true;
-    auto var = sdk->LockIfDifferentThread();
-    return channel->Connect();
+    return sdk->Run([&]() { return channel->Connect(); });
 }
 
 bool
 SdkChannelWraper::Close()
 {
-    auto var = sdk->LockIfDifferentThread();
-    return channel->Close();
+    return sdk->Run([&]() { return channel->Close(); });
 }
 
 RawData::tLen
 SdkChannelWraper::Send(RawDataPtr data)
 {
-    auto var = sdk->LockIfDifferentThread();
-    return channel->Send(data);
+    return sdk->Run([&]() { return channel->Send(data); });
 }
 
 std::tuple<RawData::tLen, RawDataPtr>
 SdkChannelWraper::Recv(RawData::tLen len)
 {
-    auto var = sdk->LockIfDifferentThread();
-    return channel->Recv(len);
+    return sdk->Run([&]() { return channel->Recv(len); });
+}
+
+RawData::tLen
+SdkChannelWraper::Borrow(RawData::tLen len, const char **data)
+{
+    return sdk->Run([&]() {
+        auto [ret, rawData] = channel->Recv(len);
+        if (ret <= 0)
+            return ret;
+
+        *data = rawData->GetData();
+        borrowed[*data] = rawData;
+        return ret;
+    });
+}
+
+bool
+SdkChannelWraper::Release(const char *data)
+{
+    return sdk->Run([&]() { return borrowed.erase(data) > 0; });
+}
+
+RawData::tLen
+SdkChannelWraper::SendV(const std::vector<RawDataPtr> &buffers)
+{
+    return sdk->Run([&]() -> RawData::tLen {
+        tUint64 total = 0;
+        for (auto &buf : buffers)
+            total += buf->Len;
+
+        auto len = (RawData::tLen)std::min(total, (tUint64)channel->HaveBufferToWrite());
+        if (len <= 0)
+            return -1;
+
+        auto rawData = NewRawDataPtr(len);
+        for (auto &buf : buffers) {
+            if (rawData->Len == len)
+                break;
+            rawData->AddData(buf->GetData(), std::min(buf->Len, len - rawData->Len));
+        }
+
+        return channel->Send(rawData);
+    });
+}
+
+RawData::tLen
+SdkChannelWraper::RecvV(const std::vector<std::tuple<char *, RawData::tLen>> &buffers)
+{
+    return sdk->Run([&]() -> RawData::tLen {
+        RawData::tLen received = 0;
+        for (auto &[buf, capa] : buffers) {
+            RawData::tLen filled = 0;
+            while (filled < capa) {
+                auto [ret, rawData] = channel->Recv(capa - filled);
+                if (ret <= 0)
+                    return received > 0 ? received : ret;
+                memcpy(buf + filled, rawData->GetData(), rawData->Len);
+                filled += rawData->Len;
+                received += rawData->Len;
+            }
+        }
+        return received;
+    });
 }
 
 void
@@ -18,6 +18,7 @@
 #define __SRC_CPP_SDK_SDKCHANNELWRAPER_HH__
 
 #include <Channel.hh>
+#include <map>
 
 namespace sdk
 {
@@ -74,6 +75,26 @@ public:
     std::tuple<RawData::tLen, RawDataPtr>
     Recv(RawData::tLen len);
 
+    // Same as Recv, but the received buffer stays with the wrapper and only
+    // its data pointer is handed out. It stays valid until Release().
+    RawData::tLen
+    Borrow(RawData::tLen len, const char **data);
+
+    bool
+    Release(const char *data);
+
+    // Gathers the buffers into one write, as much of them as the channel
+    // window allows. Returns the number of bytes sent or -1 when nothing
+    // could be sent.
+    RawData::tLen
+    SendV(const std::vector<RawDataPtr> &buffers);
+
+    // Fills the buffers in order from as many queued chunks as available.
+    // Returns the number of bytes received or, if nothing was received, the
+    // value Recv would return.
+    RawData::tLen
+    RecvV(const std::vector<std::tuple<char *, RawData::tLen>> &buffers);
+
     bool
     HaveDataToRead()            { return channel->HaveDataToRead(); }
 
@@ -108,6 +129,9 @@ public:
     bool
     IsResponeded()              { return responded; }
 
+    SdkPtr
+    GetSdk()                    { return sdk; }
+
     void
     SetUserTag(tString tag)     { channel->SetUserTag(tag); }
 
@@ -151,6 +175,8 @@ private:
     SdkPtr                      sdk;
     SdkChannelEventHandlerPtr   eventHandler;
     bool                        responded;
+    std::map<const char *, RawDataPtr>
+                                borrowed;
 };
 DefineMakeSharedPtr(SdkChannelWraper);
 
@@ -94,12 +94,17 @@ SDKConfig::SDKConfig():
     autoReconnect(false),
     maxReconnectAttempts(MAX_RECONNECTION_TRY),
     autoReconnectInterval(5),
+    connectionStripes(1),
+    upstreamPoolSize(0),
+    keepAliveProbeInterval(0),
     reverseProxy(true),
     xForwardedFor(false),
     httpsOnly(false),
     originalRequestUrl(false),
     allowPreflight(false)
 {
+    baseSocketTuning.notsent_lowat = BASE_SOCKET_NOTSENT_LOWAT;
+    upstreamSocketTuning.nodelay = 1;
 }
 
 tString
@@ -252,6 +257,11 @@ SDKConfigPtr SDKConfig::clone()
     PLAIN_COPY(autoReconnect);
     PLAIN_COPY(maxReconnectAttempts);
     PLAIN_COPY(autoReconnectInterval);
+    PLAIN_COPY(connectionStripes);
+    PLAIN_COPY(upstreamPoolSize);
+    PLAIN_COPY(keepAliveProbeInterval);
+    PLAIN_COPY(baseSocketTuning);
+    PLAIN_COPY(upstreamSocketTuning);
     PLAIN_COPY(reverseProxy);
     PLAIN_COPY(xForwardedFor);
     PLAIN_COPY(httpsOnly);
@@ -20,11 +20,19 @@
 #include <utils/Utils.hh>
 #include <vector>
 #include <utils/TunnelCommon.hh>
+#include <net/NetworkConnection.hh>
+#include <algorithm>
+
+#define MAX_CONNECTION_STRIPES 8
+#define MAX_UPSTREAM_POOL_SIZE 64
+#define BASE_SOCKET_NOTSENT_LOWAT (16*1024)
+#define MIN_KEEPALIVE_PROBE_INTERVAL 100 //ms
 
 namespace sdk
 {
 
 class Sdk;
+class ServerConnector;
 
 DeclareStructWithSharedPtr(HeaderMod);
 DeclareStructWithSharedPtr(UserPass);
@@ -108,6 +116,21 @@ struct SDKConfig: virtual public pinggy::SharedObject
     tUint16
     GetAutoReconnectInterval()  { return autoReconnectInterval; }
 
+    tUint8
+    GetConnectionStripes()      { return connectionStripes; }
+
+    tUint16
+    GetUpstreamPoolSize()       { return upstreamPoolSize; }
+
+    net::SocketTuning
+    GetBaseSocketTuning()       { return baseSocketTuning; }
+
+    net::SocketTuning
+    GetUpstreamSocketTuning()   { return upstreamSocketTuning; }
+
+    tUint16
+    GetKeepAliveProbeInterval() { return keepAliveProbeInterval; }
+
     tString //json
     GetForwardings();
 
@@ -212,6 +235,37 @@ struct SDKConfig: virtual public pinggy::SharedObject
     SetAutoReconnectInterval(tUint16 autoReconnectInterval)
                                 { isAllowed(); this->autoReconnectInterval = autoReconnectInterval > 1 ? autoReconnectInterval : 1; }
 
+    // Number of base connections a tunnel may spread its channels over. The
+    // server decides the upper limit, 1 disables striping.
+    void
+    SetConnectionStripes(tUint8 connectionStripes)
+                                { isAllowed(); this->connectionStripes = std::max((tUint8)1, std::min(connectionStripes, (tUint8)MAX_CONNECTION_STRIPES)); }
+
+    // Number of connections to each local forwarding target kept open ahead
+    // of visitors. 0 disables the pool.
+    void
+    SetUpstreamPoolSize(tUint16 upstreamPoolSize)
+                                { isAllowed(); this->upstreamPoolSize = std::min(upstreamPoolSize, (tUint16)MAX_UPSTREAM_POOL_SIZE); }
+
+    // Socket options for the connections to the pinggy server. By default only
+    // TCP_NOTSENT_LOWAT is set, it keeps the unsent part of the send queue
+    // short so a new channel does not wait behind a bulk transfer.
+    void
+    SetBaseSocketTuning(net::SocketTuning baseSocketTuning)
+                                { isAllowed(); this->baseSocketTuning = baseSocketTuning; }
+
+    // Socket options for the connections to local forwarding targets. By
+    // default only TCP_NODELAY is set.
+    void
+    SetUpstreamSocketTuning(net::SocketTuning upstreamSocketTuning)
+                                { isAllowed(); this->upstreamSocketTuning = upstreamSocketTuning; }
+
+    // Interval in ms of the extra keepalives sent while the keepalive rtt
+    // varies a lot, to measure it more often. 0 disables them.
+    void
+    SetKeepAliveProbeInterval(tUint16 interval)
+                                { isAllowed(); this->keepAliveProbeInterval = interval ? std::max(interval, (tUint16)MIN_KEEPALIVE_PROBE_INTERVAL) : 0; }
+
     void
     AddForwarding(tString forwardingType, tString bindingUrl, tString forwardTo);
 
@@ -287,6 +341,7 @@ struct SDKConfig: virtual public pinggy::SharedObject
 
 private:
     friend class Sdk;
+    friend class ServerConnector;
 
     //The token and any other parameters as well.
     tString                     token;
@@ -330,6 +385,11 @@ private:
     bool                        autoReconnect;
     tUint16                     maxReconnectAttempts;
     tUint16                     autoReconnectInterval;
+    tUint8                      connectionStripes;
+    tUint16                     upstreamPoolSize;
+    net::SocketTuning           baseSocketTuning;
+    net::SocketTuning           upstreamSocketTuning;
+    tUint16                     keepAliveProbeInterval;
 
     //Other argument options
     std::vector<HeaderModPtr>   headerManipulations;
@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "SdkRuntime.hh"
+#include "SdkException.hh"
+#include <platform/Log.hh>
+#ifndef __WINDOWS_OS__
+#include <poll/PinggyPollLinux.hh>
+#else
+#include <poll/PinggyPollGeneric.hh>
+#endif
+
+
+namespace sdk
+{
+
+/*
+ * A tunnel as seen by its reactor. It waits on the tunnel's poll controller
+ * fd (an epoll/kqueue fd is pollable itself) and on the tunnel's next timer,
+ * and serves the tunnel when either fires.
+ */
+class SdkHostedTunnel: public common::PollEventHandler
+{
+public:
+    SdkHostedTunnel(SdkPtr sdk, SdkReactor *reactor):
+            sdk(sdk),
+            reactor(reactor),
+            pollFd(InValidSocket)
+                                { }
+
+    virtual
+    ~SdkHostedTunnel()          { }
+
+    void
+    Serve();
+
+    void
+    Stop();
+
+    // PollEventHandler
+    virtual sock_t
+    GetFd() override            { return pollFd; }
+
+    virtual len_t
+    HandlePollRecv() override   { Serve(); return 0; }
+
+    virtual len_t
+    HandlePollError(int16_t) override
+                                { Serve(); return 0; }
+
+    DefineMandatoryFileLocalClassFunctionsWOSuper(SdkHostedTunnel);
+
+private:
+    void
+    unwatch();
+
+    SdkPtr                      sdk;
+    SdkReactor                 *reactor;
+    common::PollControllerPtr   tunnelPoll;
+    sock_t                      pollFd;
+    common::PollableTaskPtr     timer;
+};
+DefineMakeSharedPtr(SdkHostedTunnel);
+
+void
+SdkHostedTunnel::Serve()
+{
+    if (timer) {
+        timer->DisArm();
+        timer = nullptr;
+    }
+
+    common::PollControllerPtr poll = nullptr;
+    tInt32 timeout = -1;
+    bool alive = false;
+    try {
+        alive = sdk->ServeOnce(poll, timeout);
+    } catch (const std::exception &e) {
+        LOGE("Hosted tunnel failed:", e.what());
+        alive = false;
+    }
+
+    if (!alive || poll != tunnelPoll)
+        unwatch();
+
+    if (!alive) {
+        reactor->removeTunnel(thisPtr);
+        return;
+    }
+
+    if (!tunnelPoll && poll) {
+        tunnelPoll = poll;
+        pollFd = poll->GetFd();
+        if (IsValidSocket(pollFd))
+            reactor->pollController->RegisterHandler(thisPtr);
+    }
+
+    if (timeout < 0 && IsValidSocket(pollFd))
+        return;
+
+    tDuration delay = timeout < 0 ? SDK_RUNTIME_FALLBACK_TICK : timeout*MILLISECOND;
+    if (!IsValidSocket(pollFd))
+        delay = std::min(delay, (tDuration)SDK_RUNTIME_FALLBACK_TICK);
+    timer = reactor->pollController->SetTimeout(delay, MILLISECOND, thisPtr, &SdkHostedTunnel::Serve);
+}
+
+void
+SdkHostedTunnel::Stop()
+{
+    try {
+        sdk->Stop();
+    } catch (const std::exception &e) {
+        LOGE("Could not stop hosted tunnel:", e.what());
+    }
+    Serve();
+}
+
+void
+SdkHostedTunnel::unwatch()
+{
+    if (IsValidSocket(pollFd))
+        reactor->pollController->DeregisterHandler(thisPtr);
+    pollFd = InValidSocket;
+    tunnelPoll = nullptr;
+}
+
+//==============================================================
+
+SdkReactor::SdkReactor():
+        pollFd(InValidSocket),
+        notificationFd(InValidSocket),
+        stopping(false),
+        done(false),
+        tunnelCount(0)
+{
+#ifdef __WINDOWS_OS__
+    pollController = common::NewPollControllerGenericPtr();
+#else
+    pollController = common::NewPollControllerLinuxPtr();
+#endif
+
+    sock_t fds[2];
+    if (app_socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        throw SdkException("Could not create reactor notification channel");
+    }
+    pollFd = fds[0];
+    notificationFd = fds[1];
+}
+
+SdkReactor::~SdkReactor()
+{
+    Stop();
+    CloseNCleanSocket(pollFd);
+    CloseNCleanSocket(notificationFd);
+}
+
+void
+SdkReactor::Start()
+{
+    pollController->RegisterHandler(thisPtr);
+    thread = std::thread(&SdkReactor::threadLoop, this);
+}
+
+void
+SdkReactor::Stop()
+{
+    if (!thread.joinable())
+        return;
+
+    if (thread.get_id() == std::this_thread::get_id()) {
+        throw SdkException("A reactor cannot be stopped from its own thread");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pendingLock);
+        stopping = true;
+    }
+    app_send(notificationFd, "1", 1, 0);
+    thread.join();
+}
+
+bool
+SdkReactor::AddTunnel(SdkPtr sdk)
+{
+    {
+        std::lock_guard<std::mutex> lock(pendingLock);
+        if (stopping)
+            return false;
+        pending.push_back(sdk);
+    }
+    tunnelCount.fetch_add(1, std::memory_order_relaxed);
+    if (app_send(notificationFd, "1", 1, 0) <= 0) {
+        LOGE("Could not notify reactor");
+    }
+    return true;
+}
+
+len_t
+SdkReactor::HandlePollRecv()
+{
+    char buf[100];
+    if (app_recv(pollFd, buf, sizeof(buf), 0) <= 0) {
+        LOGE("Reactor notification channel closed");
+    }
+
+    std::vector<SdkPtr> newTunnels;
+    bool stop;
+    {
+        std::lock_guard<std::mutex> lock(pendingLock);
+        newTunnels.swap(pending);
+        stop = stopping;
+    }
+
+    for (auto sdk : newTunnels) {
+        auto tunnel = NewSdkHostedTunnelPtr(sdk, this);
+        tunnels.insert(tunnel);
+        tunnel->Serve();
+    }
+
+    if (stop) {
+        // Serve removes ended tunnels from the set
+        auto running = tunnels;
+        for (auto tunnel : running)
+            tunnel->Stop();
+        done = tunnels.empty();
+    }
+    return 0;
+}
+
+len_t
+SdkReactor::HandlePollError(int16_t)
+{
+    LOGE("Reactor notification channel failed");
+    return 0;
+}
+
+void
+SdkReactor::threadLoop()
+{
+    while (!done) {
+        auto ret = pollController->PollOnce(-1);
+        if (ret < 0 && app_get_errno() != EINTR) {
+            LOGE("Reactor poll failed:", app_get_errno());
+            break;
+        }
+    }
+
+    for (auto tunnel : std::set<SdkHostedTunnelPtr>(tunnels))
+        tunnel->Stop();
+    tunnels.clear();
+    pollController->DeregisterAllHandlers();
+}
+
+void
+SdkReactor::removeTunnel(SdkHostedTunnelPtr tunnel)
+{
+    if (tunnels.erase(tunnel))
+        tunnelCount.fetch_sub(1, std::memory_order_relaxed);
+
+    if (tunnels.empty()) {
+        std::lock_guard<std::mutex> lock(pendingLock);
+        done = stopping && pending.empty();
+    }
+}
+
+//==============================================================
+
+SdkRuntime::SdkRuntime(tUint16 numReactors):
+        nextReactor(0),
+        stopped(false)
+{
+    numReactors = std::max((tUint16)1, std::min(numReactors, (tUint16)SDK_RUNTIME_MAX_REACTORS));
+    for (tUint16 i = 0; i < numReactors; i++) {
+        auto reactor = NewSdkReactorPtr();
+        reactor->Start();
+        reactors.push_back(reactor);
+    }
+}
+
+SdkRuntime::~SdkRuntime()
+{
+    Stop();
+}
+
+bool
+SdkRuntime::AddTunnel(SdkPtr sdk, tInt32 reactor)
+{
+    if (reactor >= (tInt32)reactors.size()) {
+        throw SdkException("No such reactor in the runtime");
+    }
+    if (reactor < 0)
+        reactor = nextReactor.fetch_add(1, std::memory_order_relaxed) % reactors.size();
+    return reactors[reactor]->AddTunnel(sdk);
+}
+
+void
+SdkRuntime::Stop()
+{
+    std::lock_guard<std::mutex> lock(stopLock);
+    if (stopped)
+        return;
+    for (auto reactor : reactors)
+        reactor->Stop();
+    stopped = true;
+}
+
+tUint32
+SdkRuntime::GetTunnelCount()
+{
+    tUint32 count = 0;
+    for (auto reactor : reactors)
+        count += reactor->GetTunnelCount();
+    return count;
+}
+
+} // namespace sdk
+
+INCLUDE_MEMORY_DUMP_DEFINITION
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __SRC_CPP_SDK_SDKRUNTIME_HH__
+#define __SRC_CPP_SDK_SDKRUNTIME_HH__
+
+#include <poll/PinggyPoll.hh>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "Sdk.hh"
+
+#define SDK_RUNTIME_MAX_REACTORS    64
+// Tick for tunnels whose poll controller has no fd to wait on (windows)
+#define SDK_RUNTIME_FALLBACK_TICK   (10*MILLISECOND)
+
+namespace sdk
+{
+
+DeclareClassWithSharedPtr(SdkHostedTunnel);
+DeclareClassWithSharedPtr(SdkReactor);
+DeclareClassWithSharedPtr(SdkRuntime);
+
+/*
+ * One reactor thread of a runtime. It serves every tunnel handed to it from
+ * its own poll loop: a tunnel's poll controller fd is registered here, and
+ * so is the tunnel's next timer. A tunnel is served when either fires and
+ * the reactor thread is the one running it, the same way the thread that
+ * calls Sdk::Start would.
+ *
+ * Only the threads are shared. Each tunnel keeps its own poll controller,
+ * as the sdk replaces it and deregisters all of its handlers on reconnect,
+ * so a reactor with N tunnels waits on N nested epoll/kqueue fds.
+ */
+class SdkReactor final: virtual public pinggy::SharedObject, public common::PollEventHandler
+{
+public:
+    SdkReactor();
+
+    virtual
+    ~SdkReactor();
+
+    void
+    Start();
+
+    // Stops the hosted tunnels and waits for the thread to exit.
+    void
+    Stop();
+
+    bool
+    AddTunnel(SdkPtr sdk);
+
+    tUint32
+    GetTunnelCount()            { return tunnelCount.load(std::memory_order_relaxed); }
+
+    // PollEventHandler
+    virtual sock_t
+    GetFd() override            { return pollFd; }
+
+    virtual len_t
+    HandlePollRecv() override;
+
+    virtual len_t
+    HandlePollError(int16_t) override;
+
+    DefineMandatoryClassFunctionsWOSuper(SdkReactor);
+
+private:
+    friend class SdkHostedTunnel;
+
+    void
+    threadLoop();
+
+    void
+    removeTunnel(SdkHostedTunnelPtr tunnel);
+
+    common::PollControllerPtr   pollController;
+    std::thread                 thread;
+    sock_t                      pollFd;
+    sock_t                      notificationFd;
+
+    std::mutex                  pendingLock;
+    std::vector<SdkPtr>         pending;
+    bool                        stopping;           // guarded by pendingLock
+    bool                        done;               // reactor thread only
+
+    std::set<SdkHostedTunnelPtr>
+                                tunnels;            // reactor thread only
+    std::atomic<tUint32>        tunnelCount;
+};
+DefineMakeSharedPtr(SdkReactor);
+
+/*
+ * Hosts many tunnels on a fixed set of reactor threads, instead of one
+ * thread per tunnel. Tunnels are bound with Sdk::SetRuntime before they are
+ * started; Sdk::Start then hands them to a reactor, either the pinned one or
+ * the next one in round robin order.
+ */
+class SdkRuntime: virtual public pinggy::SharedObject
+{
+public:
+    SdkRuntime(tUint16 numReactors);
+
+    virtual
+    ~SdkRuntime();
+
+    bool
+    AddTunnel(SdkPtr sdk, tInt32 reactor = -1);
+
+    // Stops every hosted tunnel and the reactor threads. It cannot be called
+    // from a reactor thread, i.e. from a callback of a hosted tunnel.
+    void
+    Stop();
+
+    tUint16
+    GetReactorCount()           { return (tUint16)reactors.size(); }
+
+    tUint32
+    GetTunnelCount();
+
+    DefineMandatoryClassFunctionsWOSuper(SdkRuntime);
+
+private:
+    std::vector<SdkReactorPtr>  reactors;
+    std::atomic<tUint32>        nextReactor;
+    std::mutex                  stopLock;
+    bool                        stopped;
+};
+DefineMakeSharedPtr(SdkRuntime);
+
+} // namespace sdk
+
+#endif // __SRC_CPP_SDK_SDKRUNTIME_HH__
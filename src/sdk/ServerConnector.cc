@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ServerConnector.hh"
+#include <platform/Log.hh>
+
+namespace sdk
+{
+
+ServerConnector::ServerConnector(SDKConfigPtr sdkConfig, common::PollControllerPtr pollController,
+                                 tString baseCertificate, Callback callback):
+            sdkConfig(sdkConfig),
+            pollController(pollController),
+            baseCertificate(baseCertificate),
+            callback(callback),
+            done(false)
+{
+}
+
+void
+ServerConnector::Start(tUint64 timeout)
+{
+    auto serverAddress = sdkConfig->serverAddress;
+    tcpConn = net::NewNetworkConnectionImplPtr(serverAddress->GetRawHost(), serverAddress->GetPortStr(), false);
+    tcpConn->SetPollController(pollController);
+    tcpConn->SetResolver(resolver);
+    tcpConn->ApplySocketTuning(sdkConfig->baseSocketTuning);
+    deadlineTimer = pollController->SetTimeout(timeout, thisPtr, &ServerConnector::deadlineReached);
+    tcpConn->Connect(thisPtr);
+}
+
+void
+ServerConnector::Cancel()
+{
+    if (done)
+        return;
+    done = true;
+    closeConnections();
+    callback = nullptr;
+}
+
+len_t
+ServerConnector::HandleConnected(net::NetworkConnectionImplPtr netConn)
+{
+    if (done || netConn != tcpConn) {
+        netConn->CloseConn();
+        return 0;
+    }
+
+    if (!sdkConfig->ssl) {
+        finish(tcpConn, "");
+        return 0;
+    }
+
+    try {
+        sslConn = net::NewSslNetworkConnectionPtr(tcpConn, sdkConfig->sniServerName);
+        sslConn->SetBaseCertificate(baseCertificate);
+        sslConn->ConnectAsync(thisPtr, nullptr);
+    } catch (const std::exception &e) {
+        LOGE("Could not start ssl handshake: ", e.what());
+        finish(nullptr, e.what());
+    }
+    return 0;
+}
+
+len_t
+ServerConnector::HandleConnectionFailed(net::NetworkConnectionImplPtr netConn)
+{
+    if (done || netConn != tcpConn)
+        return 0;
+    finish(nullptr, "Could not connect to server");
+    return 0;
+}
+
+void
+ServerConnector::SslConnected(net::SslNetworkConnectionPtr conn, pinggy::VoidPtr)
+{
+    if (done || conn != sslConn)
+        return;
+    sslConn->EnableWriteCoalescing();
+    finish(sslConn, "");
+}
+
+void
+ServerConnector::SslConnectionFailed(net::SslNetworkConnectionPtr conn, pinggy::VoidPtr)
+{
+    if (done || conn != sslConn)
+        return;
+    finish(nullptr, "Ssl handshake failed");
+}
+
+void
+ServerConnector::deadlineReached()
+{
+    deadlineTimer = nullptr;
+    if (done)
+        return;
+    LOGE("Timeout while connecting to server");
+    finish(nullptr, "Timeout while connecting to server");
+}
+
+void
+ServerConnector::finish(net::NetworkConnectionPtr netConn, tString error)
+{
+    done = true;
+    if (!netConn)
+        closeConnections();
+    if (deadlineTimer) {
+        deadlineTimer->DisArm();
+        deadlineTimer = nullptr;
+    }
+
+    auto cb = callback;
+    callback = nullptr;
+    tcpConn = nullptr;
+    sslConn = nullptr;
+    if (cb)
+        cb(netConn, error);
+}
+
+void
+ServerConnector::closeConnections()
+{
+    if (deadlineTimer) {
+        deadlineTimer->DisArm();
+        deadlineTimer = nullptr;
+    }
+    if (sslConn) {
+        sslConn->DeregisterFDEvenHandler();
+        sslConn->CloseConn();
+    } else if (tcpConn) {
+        tcpConn->CloseConn();
+    }
+    sslConn = nullptr;
+    tcpConn = nullptr;
+}
+
+} // namespace sdk
+
+INCLUDE_MEMORY_DUMP_DEFINITION
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SRC_CPP_SDK_SERVERCONNECTOR_HH__
+#define __SRC_CPP_SDK_SERVERCONNECTOR_HH__
+
+#include <net/NetworkConnection.hh>
+#include <net/SslNetworkConnection.hh>
+#include <net/AsyncResolver.hh>
+#include <poll/PinggyPoll.hh>
+#include <functional>
+#include "SdkConfig.hh"
+
+#define SERVER_CONNECT_TIMEOUT (10*SECOND)
+
+namespace sdk
+{
+
+DeclareClassWithSharedPtr(ServerConnector);
+
+/*
+ * Connects to the pinggy server without blocking the poll thread. TCP connect
+ * and TLS handshake run as poll events, the whole thing is bounded by a
+ * deadline. The callback fires exactly once, with either a ready connection
+ * or an error. A cancelled connector never calls back.
+ */
+class ServerConnector:
+        virtual public net::NonBlockingConnectEventHandler,
+        virtual public net::SslConnectHandler
+{
+public:
+    typedef std::function<void(net::NetworkConnectionPtr, tString)>
+                                Callback;
+
+    ServerConnector(SDKConfigPtr sdkConfig, common::PollControllerPtr pollController,
+                    tString baseCertificate, Callback callback);
+
+    virtual
+    ~ServerConnector()          { }
+
+    void
+    Start(tUint64 timeout = SERVER_CONNECT_TIMEOUT);
+
+    void
+    Cancel();
+
+    bool
+    IsDone()                    { return done; }
+
+    void
+    SetResolver(net::AsyncResolverPtr resolver)
+                                { this->resolver = resolver; }
+
+//net::NonBlockingConnectEventHandler
+    virtual len_t
+    HandleConnected(net::NetworkConnectionImplPtr netConn) override;
+
+    virtual len_t
+    HandleConnectionFailed(net::NetworkConnectionImplPtr netConn) override;
+
+//net::SslConnectHandler
+    virtual void
+    SslConnected(net::SslNetworkConnectionPtr sslConn, pinggy::VoidPtr asyncConnectPtr) override;
+
+    virtual void
+    SslConnectionFailed(net::SslNetworkConnectionPtr sslConn, pinggy::VoidPtr asyncConnectPtr) override;
+
+    DefineMandatoryClassFunctionsWOSuper(ServerConnector);
+
+private:
+    void
+    deadlineReached();
+
+    void
+    finish(net::NetworkConnectionPtr netConn, tString error);
+
+    void
+    closeConnections();
+
+    SDKConfigPtr                sdkConfig;
+    common::PollControllerPtr   pollController;
+    tString                     baseCertificate;
+    Callback                    callback;
+    net::AsyncResolverPtr       resolver;
+    net::NetworkConnectionImplPtr
+                                tcpConn;
+    net::SslNetworkConnectionPtr
+                                sslConn;
+    common::PollableTaskPtr     deadlineTimer;
+    bool                        done;
+};
+DefineMakeSharedPtr(ServerConnector);
+
+} // namespace sdk
+
+#endif // __SRC_CPP_SDK_SERVERCONNECTOR_HH__
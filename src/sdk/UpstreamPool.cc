@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "UpstreamPool.hh"
+#include <platform/Log.hh>
+
+namespace sdk
+{
+
+UpstreamPool::UpstreamPool(tString host, tString port, common::PollControllerPtr pollController,
+                           net::AsyncResolverPtr resolver, tUint16 size, tDuration maxIdleAge):
+            host(host),
+            port(port),
+            pollController(pollController),
+            resolver(resolver),
+            size(size),
+            maxIdleAge(maxIdleAge),
+            stopped(false),
+            backingOff(false)
+{
+}
+
+void
+UpstreamPool::Start()
+{
+    checkTask = pollController->SetInterval(UPSTREAM_POOL_CHECK_INTERVAL, thisPtr, &UpstreamPool::checkIdleConnections);
+    refill();
+}
+
+net::NetworkConnectionImplPtr
+UpstreamPool::Take()
+{
+    if (stopped)
+        return nullptr;
+
+    net::NetworkConnectionImplPtr netConn;
+    auto now = GetCurrentTimeInMS();
+    while (!idleConnections.empty() && !netConn) {
+        auto idleConn = idleConnections.back(); //the newest one is the least likely to be closed by the peer
+        idleConnections.pop_back();
+        if (isUsable(idleConn, now))
+            netConn = idleConn.netConn;
+        else
+            idleConn.netConn->CloseConn();
+    }
+
+    refill();
+    return netConn;
+}
+
+void
+UpstreamPool::Stop()
+{
+    if (stopped)
+        return;
+    stopped = true;
+
+    if (checkTask) {
+        checkTask->DisArm();
+        checkTask = nullptr;
+    }
+    if (retryTask) {
+        retryTask->DisArm();
+        retryTask = nullptr;
+    }
+    for (auto &idleConn : idleConnections)
+        idleConn.netConn->CloseConn();
+    idleConnections.clear();
+    for (auto netConn : connecting)
+        netConn->CloseConn();
+    connecting.clear();
+}
+
+len_t
+UpstreamPool::HandleConnected(net::NetworkConnectionImplPtr netConn)
+{
+    if (stopped || connecting.erase(netConn) == 0) {
+        netConn->CloseConn();
+        return 0;
+    }
+
+    idleConnections.push_back(IdleConnection{netConn, (tUint64)GetCurrentTimeInMS()});
+    LOGT("Upstream pool", host, port, "idle:", idleConnections.size());
+    return 0;
+}
+
+len_t
+UpstreamPool::HandleConnectionFailed(net::NetworkConnectionImplPtr netConn)
+{
+    connecting.erase(netConn);
+    if (stopped || backingOff)
+        return 0;
+
+    LOGD("Could not warm up connection to", host, port, "retrying later");
+    backingOff = true;
+    retryTask = pollController->SetTimeout(UPSTREAM_POOL_RETRY_INTERVAL, thisPtr, &UpstreamPool::retryRefill);
+    return 0;
+}
+
+void
+UpstreamPool::refill()
+{
+    if (stopped || backingOff)
+        return;
+
+    while (idleConnections.size() + connecting.size() < size) {
+        auto netConn = net::NewNetworkConnectionImplPtr(host, port, false);
+        netConn->SetPollController(pollController);
+        netConn->SetResolver(resolver);
+        netConn->ApplySocketTuning(socketTuning);
+        connecting.insert(netConn);
+        netConn->Connect(thisPtr);
+        if (backingOff) //failed synchronously
+            break;
+    }
+}
+
+void
+UpstreamPool::retryRefill()
+{
+    retryTask = nullptr;
+    backingOff = false;
+    refill();
+}
+
+void
+UpstreamPool::checkIdleConnections()
+{
+    auto now = GetCurrentTimeInMS();
+    std::deque<IdleConnection> usable;
+    for (auto &idleConn : idleConnections) {
+        if (isUsable(idleConn, now))
+            usable.push_back(idleConn);
+        else
+            idleConn.netConn->CloseConn();
+    }
+    idleConnections = usable;
+    refill();
+}
+
+bool
+UpstreamPool::isUsable(IdleConnection &idleConn, tUint64 now)
+{
+    if (now - idleConn.since > maxIdleAge)
+        return false;
+
+    //Nothing should arrive on an idle connection, except for server-first
+    // protocols where the greeting stays in the socket for the forwarder.
+    char buf[1];
+    auto ret = idleConn.netConn->Peek(buf, sizeof(buf));
+    if (ret == 0)
+        return false;
+    if (ret < 0 && !idleConn.netConn->TryAgain())
+        return false;
+    return true;
+}
+
+} // namespace sdk
+
+INCLUDE_MEMORY_DUMP_DEFINITION
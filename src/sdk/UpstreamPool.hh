@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2025 PINGGY TECHNOLOGY PRIVATE LIMITED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SRC_CPP_SDK_UPSTREAMPOOL_HH__
+#define __SRC_CPP_SDK_UPSTREAMPOOL_HH__
+
+#include <net/NetworkConnection.hh>
+#include <net/AsyncResolver.hh>
+#include <poll/PinggyPoll.hh>
+#include <deque>
+#include <set>
+
+#define UPSTREAM_POOL_MAX_IDLE_AGE      (30*SECOND)
+#define UPSTREAM_POOL_CHECK_INTERVAL    (5*SECOND)
+#define UPSTREAM_POOL_RETRY_INTERVAL    (2*SECOND)
+
+namespace sdk
+{
+
+DeclareClassWithSharedPtr(UpstreamPool);
+
+/*
+ * Keeps a few connections to a local forwarding target open ahead of demand,
+ * so that a new visitor channel does not wait for the connect. Idle
+ * connections are checked for EOF before use and closed once they get old.
+ * The pool refills itself in the background; when the target is down it
+ * backs off instead of retrying in a loop.
+ */
+class UpstreamPool: public virtual net::NonBlockingConnectEventHandler
+{
+public:
+    UpstreamPool(tString host, tString port, common::PollControllerPtr pollController,
+                 net::AsyncResolverPtr resolver, tUint16 size, tDuration maxIdleAge = UPSTREAM_POOL_MAX_IDLE_AGE);
+
+    virtual
+    ~UpstreamPool()             { }
+
+    void
+    SetSocketTuning(net::SocketTuning socketTuning)
+                                { this->socketTuning = socketTuning; }
+
+    void
+    Start();
+
+    // A connected socket, or nullptr if none is ready.
+    net::NetworkConnectionImplPtr
+    Take();
+
+    void
+    Stop();
+
+//net::NonBlockingConnectEventHandler
+    virtual len_t
+    HandleConnected(net::NetworkConnectionImplPtr netConn) override;
+
+    virtual len_t
+    HandleConnectionFailed(net::NetworkConnectionImplPtr netConn) override;
+
+    DefineMandatoryClassFunctionsWOSuper(UpstreamPool);
+
+private:
+    struct IdleConnection {
+        net::NetworkConnectionImplPtr
+                                netConn;
+        tUint64                 since;
+    };
+
+    void
+    refill();
+
+    void
+    retryRefill();
+
+    void
+    checkIdleConnections();
+
+    bool
+    isUsable(IdleConnection &idleConn, tUint64 now);
+
+    tString                     host;
+    tString                     port;
+    common::PollControllerPtr   pollController;
+    net::AsyncResolverPtr       resolver;
+    net::SocketTuning           socketTuning;
+    tUint16                     size;
+    tDuration                   maxIdleAge;
+    bool                        stopped;
+    bool                        backingOff;
+
+    std::deque<IdleConnection>  idleConnections; //newest at the back
+    std::set<net::NetworkConnectionImplPtr>
+                                connecting;
+    common::PollableTaskPtr     checkTask;
+    common::PollableTaskPtr     retryTask;
+};
+DefineMakeSharedPtr(UpstreamPool);
+
+} // namespace sdk
+
+#endif // __SRC_CPP_SDK_UPSTREAMPOOL_HH__
@@ -140,6 +140,7 @@ typedef int16_t                 pinggy_len_t;
 typedef uint32_t                pinggy_capa_t;
 typedef uint32_t               *pinggy_capa_p_t;
 typedef uint32_t                pinggy_uint32_t;
+typedef uint64_t                pinggy_uint64_t;
 typedef uint16_t                pinggy_uint16_t;
 typedef int32_t                 pinggy_int32_t;
 typedef int32_t                 pinggy_raw_len_t;
@@ -165,6 +166,102 @@ typedef enum TunnelState {
     TunnelState_Ended,
 } pinggy_tunnel_state_t;
 
+typedef enum SocketTuningTarget {
+    SocketTuningTarget_Base = 0,        // connections to the pinggy server
+    SocketTuningTarget_Upstream,        // connections to local forwarding targets
+} pinggy_socket_tuning_target_t;
+
+typedef enum SocketTuningOption {
+    SocketTuningOption_NoDelay = 0,     // TCP_NODELAY
+    SocketTuningOption_SendBuffer,      // SO_SNDBUF
+    SocketTuningOption_RecvBuffer,      // SO_RCVBUF
+    SocketTuningOption_NotSentLowat,    // TCP_NOTSENT_LOWAT
+    SocketTuningOption_QuickAck,        // TCP_QUICKACK
+    SocketTuningOption_UserTimeout,     // TCP_USER_TIMEOUT (milliseconds)
+} pinggy_socket_tuning_option_t;
+
+typedef enum TunnelEventType {
+    TunnelEvent_None = 0,
+    TunnelEvent_Overflow,               // events were dropped, recheck the tunnel and its channels
+    TunnelEvent_TunnelEstablished,
+    TunnelEvent_TunnelFailed,
+    TunnelEvent_Disconnected,
+    TunnelEvent_Error,                  // value: error number
+    TunnelEvent_UsageUpdate,            // read it with pinggy_tunnel_get_current_usages
+    TunnelEvent_NewChannel,             // channel: the new channel
+    TunnelEvent_ChannelDataReceived,
+    TunnelEvent_ChannelReadyToSend,     // value: bytes that can be sent
+    TunnelEvent_ChannelError,
+    TunnelEvent_ChannelCleanup,
+} pinggy_tunnel_event_type_t;
+
+typedef enum LogModule {
+    LogModule_All = -1,
+    LogModule_Default = 0,              // everything not listed below
+    LogModule_Poll,                     // event loop
+    LogModule_Net,                      // sockets and ssl
+    LogModule_Transport,                // multiplexing transport
+    LogModule_Protocol,                 // session and channels
+    LogModule_Sdk,
+} pinggy_log_module_t;
+
+typedef enum LogLevel {
+    LogLevel_Trace = 1,
+    LogLevel_Debug,
+    LogLevel_Info,
+    LogLevel_Error,
+    LogLevel_Fatal,
+    LogLevel_Disable = 100,
+} pinggy_log_level_t;
+
+#define PINGGY_STATS_MAX_FORWARDINGS 8
+
+typedef struct pinggy_forwarding_stats {
+    pinggy_uint32_t             forwarding_id;
+    pinggy_uint32_t             active_channels;
+    pinggy_uint64_t             bytes_to_local;         // visitor to local server
+    pinggy_uint64_t             bytes_from_local;       // local server to visitor
+    pinggy_uint64_t             total_channels;
+    pinggy_uint64_t             rejected_channels;
+} pinggy_forwarding_stats_t;
+
+/**
+ * Counters of a tunnel since it started, reconnections included. Bytes are
+ * channel payload. Latencies are in microseconds, the percentiles are upper
+ * bounds of power of two buckets.
+ */
+typedef struct pinggy_stats {
+    pinggy_uint64_t             bytes_in;
+    pinggy_uint64_t             bytes_out;
+    pinggy_uint64_t             total_channels;
+    pinggy_uint64_t             channel_setup_latency_p50;
+    pinggy_uint64_t             channel_setup_latency_p90;
+    pinggy_uint64_t             channel_setup_latency_p99;
+    pinggy_uint64_t             keepalive_rtt;          // latest sample
+    pinggy_uint64_t             keepalive_rtt_smoothed; // ewma, as the tcp retransmission timer
+    pinggy_uint64_t             keepalive_rtt_variance; // mean deviation, ewma as well
+    pinggy_uint64_t             keepalive_rtt_min;
+    pinggy_uint64_t             keepalive_rtt_max;
+    pinggy_uint64_t             keepalive_rtt_p50;
+    pinggy_uint64_t             keepalive_rtt_p90;
+    pinggy_uint64_t             keepalive_rtt_p99;
+    pinggy_uint64_t             keepalive_samples;
+    pinggy_uint32_t             active_channels;
+    pinggy_uint32_t             send_queue_depth;       // msgs waiting for the connection to the server
+    pinggy_uint32_t             reconnects;
+    pinggy_uint32_t             tls_handshakes;         // connections to the server, stripes included
+    pinggy_uint32_t             tls_sessions_resumed;   // of those, resumed from a cached tls session
+    pinggy_uint32_t             num_forwardings;        // valid entries of forwardings
+    pinggy_forwarding_stats_t   forwardings[PINGGY_STATS_MAX_FORWARDINGS];
+} pinggy_stats_t;
+
+typedef struct pinggy_tunnel_event {
+    pinggy_tunnel_event_type_t  type;
+    pinggy_ref_t                tunnel;
+    pinggy_ref_t                channel;    // INVALID_PINGGY_REF for tunnel events
+    pinggy_uint32_t             value;
+} pinggy_tunnel_event_t;
+
 /**
  * PINGGY_TYPETEST_ENABLED is a type enforcer for code. It make sure that all the code
  * Implementation used exactly same data as the declaration function.
@@ -193,6 +290,41 @@ pinggy_set_log_path(pinggy_char_p_t);
 PINGGY_EXPORT pinggy_void_t
 pinggy_set_log_enable(pinggy_bool_t);
 
+/**
+ * @brief Moves writing of the logs to a background thread.
+ *
+ * A logging thread still formats the line, then only copies it into a ring
+ * buffer of its own and returns. When a ring is full, new lines are dropped and counted.
+ * Disabling it writes out the lines still queued.
+ *
+ * @param enable   pinggy_true to enable, pinggy_false to disable.
+ * @param ring_size Bytes of ring buffer per logging thread, 0 for the default (256KB).
+ */
+PINGGY_EXPORT pinggy_void_t
+pinggy_set_async_log_enable(pinggy_bool_t enable, pinggy_uint32_t ring_size);
+
+/**
+ * @brief Number of log lines dropped because a ring buffer was full.
+ */
+PINGGY_EXPORT pinggy_uint64_t
+pinggy_get_log_dropped_count();
+
+/**
+ * @brief Sets the lowest level logged by a module while running. Levels
+ * below the one the library is compiled with are not available.
+ *
+ * @param module LogModule_All to set every module.
+ * @param level  LogLevel_Disable to silence the module.
+ */
+PINGGY_EXPORT pinggy_void_t
+pinggy_set_log_level(pinggy_log_module_t module, pinggy_log_level_t level);
+
+/**
+ * @brief Lowest level logged by a module, LogLevel_Disable for an unknown module.
+ */
+PINGGY_EXPORT pinggy_log_level_t
+pinggy_get_log_level(pinggy_log_module_t module);
+
 
 /**
  * @brief check if interruption occurred while running last command. It is just a wrapper for
@@ -661,6 +793,62 @@ pinggy_config_set_max_reconnect_attempts(pinggy_ref_t config, pinggy_uint16_t nu
 PINGGY_EXPORT pinggy_void_t
 pinggy_config_set_reconnect_interval(pinggy_ref_t config, pinggy_uint16_t interval);
 
+/**
+ * @brief Sets the number of parallel base connections the tunnel may use.
+ *
+ * Channels are spread over these connections, so a single slow connection does
+ * not stall every visitor. The server decides the actual limit. The default is 1
+ * (no striping), the maximum is 8.
+ *
+ * @param config  Reference to the tunnel config object.
+ * @param stripes Number of base connections.
+ */
+PINGGY_EXPORT pinggy_void_t
+pinggy_config_set_connection_stripes(pinggy_ref_t config, pinggy_uint16_t stripes);
+
+/**
+ * @brief Sets the number of connections to each local forwarding target kept open ahead of visitors.
+ *
+ * A new visitor takes an already connected socket from the pool instead of
+ * waiting for a connect to the local service. Idle connections are closed
+ * after 30 seconds and replaced. The default is 0 (disabled), the maximum is 64.
+ *
+ * @param config    Reference to the tunnel config object.
+ * @param pool_size Number of idle connections per forwarding.
+ */
+PINGGY_EXPORT pinggy_void_t
+pinggy_config_set_upstream_pool_size(pinggy_ref_t config, pinggy_uint16_t pool_size);
+
+/**
+ * @brief Sets the interval of the extra keepalives sent while the keepalive rtt varies a lot.
+ *
+ * Regular keepalives go out every 5 seconds. While the mean deviation of the
+ * rtt is above a quarter of the smoothed rtt, the tunnel sends extra ones at
+ * this interval to follow the rtt more closely. The default is 0 (disabled),
+ * the minimum is 100.
+ *
+ * @param config   Reference to the tunnel config object.
+ * @param interval Interval in milliseconds.
+ */
+PINGGY_EXPORT pinggy_void_t
+pinggy_config_set_keepalive_probe_interval(pinggy_ref_t config, pinggy_uint16_t interval);
+
+/**
+ * @brief Sets a socket option applied to a class of tcp connections made by the tunnel.
+ *
+ * The options are applied once the connection is established. By default the
+ * server connections use TCP_NOTSENT_LOWAT of 16KB and the connections to
+ * local forwarding targets use TCP_NODELAY. Options not supported by the
+ * platform are skipped.
+ *
+ * @param config  Reference to the tunnel config object.
+ * @param target  The connections the option applies to.
+ * @param option  The socket option.
+ * @param value   Value of the option, -1 keeps the system default.
+ */
+PINGGY_EXPORT pinggy_void_t
+pinggy_config_set_socket_tuning(pinggy_ref_t config, pinggy_socket_tuning_target_t target, pinggy_socket_tuning_option_t option, pinggy_int32_t value);
+
 //====
 
 /**
@@ -969,6 +1157,41 @@ pinggy_config_get_max_reconnect_attempts(pinggy_ref_t config);
 PINGGY_EXPORT pinggy_uint16_t
 pinggy_config_get_reconnect_interval(pinggy_ref_t config);
 
+/**
+ * @brief Retrieves the number of parallel base connections configured for the tunnel.
+ * @param config  Reference to the tunnel config object.
+ * @return        The configured number of base connections.
+ */
+PINGGY_EXPORT pinggy_uint16_t
+pinggy_config_get_connection_stripes(pinggy_ref_t config);
+
+/**
+ * @brief Retrieves the number of pre-connected upstream connections per forwarding.
+ * @param config  Reference to the tunnel config object.
+ * @return        The configured pool size, 0 if disabled.
+ */
+PINGGY_EXPORT pinggy_uint16_t
+pinggy_config_get_upstream_pool_size(pinggy_ref_t config);
+
+/**
+ * @brief Retrieves the interval of the extra keepalives sent while the rtt is unstable.
+ * @param config  Reference to the tunnel config object.
+ * @return        The interval in milliseconds, 0 if disabled.
+ */
+PINGGY_EXPORT pinggy_uint16_t
+pinggy_config_get_keepalive_probe_interval(pinggy_ref_t config);
+
+/**
+ * @brief Retrieves a socket option configured for a class of tcp connections.
+ * @param config  Reference to the tunnel config object.
+ * @param target  The connections the option applies to.
+ * @param option  The socket option.
+ * @return        The configured value, -1 if the system default is used or
+ *                the target or option is unknown.
+ */
+PINGGY_EXPORT pinggy_int32_t
+pinggy_config_get_socket_tuning(pinggy_ref_t config, pinggy_socket_tuning_target_t target, pinggy_socket_tuning_option_t option);
+
 //========
 
 /**
@@ -1158,6 +1381,47 @@ pinggy_config_get_webdebugger(pinggy_ref_t config);
 PINGGY_EXPORT pinggy_ref_t
 pinggy_tunnel_initiate(pinggy_ref_t config);
 
+/**
+ * @brief Creates a runtime which serves many tunnels on a fixed set of reactor threads.
+ *
+ * Tunnels initiated with @ref pinggy_tunnel_initiate_in_runtime do not need a
+ * thread of their own, the reactor threads of the runtime serve them. Their
+ * callbacks run on the reactor thread serving the tunnel.
+ *
+ * @param num_reactors Number of reactor threads, between 1 and 64.
+ * @return             Reference to the runtime.
+ */
+PINGGY_EXPORT pinggy_ref_t
+pinggy_runtime_create(pinggy_uint16_t num_reactors);
+
+/**
+ * @brief Initializes a new tunnel object hosted by a runtime.
+ *
+ * Same as @ref pinggy_tunnel_initiate, except that @ref pinggy_tunnel_start
+ * and @ref pinggy_tunnel_start_non_blocking hand the tunnel to a reactor of
+ * the runtime and return immediately. @ref pinggy_tunnel_resume must not be
+ * called for such a tunnel.
+ *
+ * @param runtime Reference to the runtime.
+ * @param config  Reference to the tunnel config object.
+ * @param reactor Index of the reactor to pin the tunnel to, negative to assign reactors round robin.
+ * @return        Reference to the newly created tunnel object.
+ */
+PINGGY_EXPORT pinggy_ref_t
+pinggy_tunnel_initiate_in_runtime(pinggy_ref_t runtime, pinggy_ref_t config, pinggy_int32_t reactor);
+
+/**
+ * @brief Stops every tunnel hosted by the runtime and its reactor threads.
+ *
+ * It must not be called from a tunnel callback. Tunnels cannot be started in
+ * the runtime afterwards.
+ *
+ * @param runtime Reference to the runtime.
+ * @return        pinggy_true on success, pinggy_false on failure.
+ */
+PINGGY_EXPORT pinggy_bool_t
+pinggy_runtime_stop(pinggy_ref_t runtime);
+
 /**
  * @brief Starts and serves the tunnel, blocking indefinitely until stopped.
  *
@@ -1280,6 +1544,20 @@ pinggy_tunnel_get_current_usages(pinggy_ref_t tunnel, pinggy_capa_t capa, pinggy
 PINGGY_EXPORT pinggy_const_int_t
 pinggy_tunnel_get_current_usages_len(pinggy_ref_t tunnel, pinggy_capa_t capa, pinggy_char_p_t val, pinggy_capa_p_t max_len);
 
+/**
+ * @brief Copies the current counters of the tunnel into `stats`.
+ *
+ * It does not wait for the thread serving the tunnel and can be called from
+ * any thread. Only the first PINGGY_STATS_MAX_FORWARDINGS forwardings are
+ * reported.
+ *
+ * @param tunnel     Reference to the tunnel object.
+ * @param stats      Structure to fill in.
+ * @return           pinggy_true on success, pinggy_false on failure.
+ */
+PINGGY_EXPORT pinggy_bool_t
+pinggy_tunnel_get_stats(pinggy_ref_t tunnel, pinggy_stats_t *stats);
+
 /**
  * @brief Retrieves greeting messages for the tunnel as a JSON string.
  *
@@ -1356,6 +1634,49 @@ pinggy_tunnel_get_webdebugging_addr_len(pinggy_ref_t tunnel, pinggy_capa_t capa,
 PINGGY_EXPORT pinggy_tunnel_state_t
 pinggy_tunnel_get_state(pinggy_ref_t tunnel);
 
+/**
+ * @brief Makes the tunnel queue its events for pinggy_tunnel_poll_events.
+ *
+ * Tunnel events and the events of channels created afterwards are put into a
+ * ring buffer, in addition to any registered callback. It must be called
+ * before the tunnel is started. After TunnelEvent_ChannelCleanup the
+ * application frees the channel reference unless a cleanup callback is set.
+ *
+ * @param tunnel   Reference to the tunnel object.
+ * @param capacity Number of events the ring holds, rounded up to a power of two. 0 selects 1024.
+ * @return         pinggy_true on success, pinggy_false on failure.
+ */
+PINGGY_EXPORT pinggy_bool_t
+pinggy_tunnel_enable_event_queue(pinggy_ref_t tunnel, pinggy_uint32_t capacity);
+
+/**
+ * @brief Takes queued events of the tunnel.
+ *
+ * Must not be called from more than one thread at a time. When the ring
+ * was full and events were dropped, a TunnelEvent_Overflow event comes
+ * first.
+ *
+ * @param tunnel     Reference to the tunnel object.
+ * @param events     Array receiving the events.
+ * @param max_events Size of the array.
+ * @param timeout_ms Milliseconds to wait when no event is queued. 0 does not wait, -1 waits forever.
+ * @return           Number of events stored in the array, or negative value on error.
+ */
+PINGGY_EXPORT pinggy_int32_t
+pinggy_tunnel_poll_events(pinggy_ref_t tunnel, pinggy_tunnel_event_t *events, pinggy_uint32_t max_events, pinggy_int32_t timeout_ms);
+
+/**
+ * @brief Retrieves a file descriptor that is readable while events are queued.
+ *
+ * Meant for host event loops. It is an eventfd on linux and a socket elsewhere.
+ * pinggy_tunnel_poll_events clears it; the application must not read from it.
+ *
+ * @param tunnel Reference to the tunnel object.
+ * @return       The descriptor, or -1 if the event queue is not enabled.
+ */
+PINGGY_EXPORT pinggy_int32_t
+pinggy_tunnel_get_event_fd(pinggy_ref_t tunnel);
+
 
 //=====================================
 //      Callbacks
@@ -1514,6 +1835,27 @@ typedef pinggy_void_t (*pinggy_channel_on_data_received_cb_t)(pinggy_void_p_t, p
 typedef pinggy_void_t (*pinggy_channel_on_readyto_send_cb_t)(pinggy_void_p_t, pinggy_ref_t, pinggy_uint32_t);
 typedef pinggy_void_t (*pinggy_channel_on_error_cb_t)(pinggy_void_p_t, pinggy_ref_t, pinggy_const_char_p_t, pinggy_len_t);
 typedef pinggy_void_t (*pinggy_channel_on_cleanup_cb_t)(pinggy_void_p_t, pinggy_ref_t);
+typedef pinggy_void_t (*pinggy_channel_data_free_cb_t)(pinggy_void_p_t, pinggy_char_p_t);
+
+/**
+ * @brief A buffer for the scatter/gather channel functions. Same idea as the
+ * posix `struct iovec`, which is not available on every platform.
+ */
+typedef struct pinggy_iovec {
+    pinggy_void_p_t             base;
+    pinggy_raw_len_t            len;
+} pinggy_iovec_t;
+
+/**
+ * @brief One entry of pinggy_tunnel_channels_poll. The application sets
+ * `channel`, the rest is filled in by the library.
+ */
+typedef struct pinggy_channel_poll {
+    pinggy_ref_t                channel;
+    pinggy_bool_t               readable;   // data or end of stream is waiting
+    pinggy_bool_t               connected;
+    pinggy_uint32_t             writable;   // bytes that can be sent now
+} pinggy_channel_poll_t;
 
 
 
@@ -1611,6 +1953,25 @@ pinggy_tunnel_channel_close(pinggy_ref_t channel);
 PINGGY_EXPORT pinggy_raw_len_t
 pinggy_tunnel_channel_send(pinggy_ref_t channel, pinggy_const_char_p_t data, pinggy_raw_len_t data_len);
 
+/**
+ * @brief Sends data to the channel without copying it.
+ *
+ * The library takes ownership of the buffer with this call, whether the send
+ * succeeds or not. free_cb is called exactly once, with user_data and data,
+ * when the library no longer needs the buffer. It may be called before this
+ * function returns or later from the tunnel thread. The buffer must not be
+ * modified until then.
+ *
+ * @param channel   Reference to the channel object.
+ * @param data      Pointer to the data to send.
+ * @param data_len  Length of the data to send.
+ * @param free_cb   Function called to give the buffer back to the application.
+ * @param user_data User data to be passed to free_cb.
+ * @return          Number of bytes sent, or negative value on error.
+ */
+PINGGY_EXPORT pinggy_raw_len_t
+pinggy_tunnel_channel_send_owned(pinggy_ref_t channel, pinggy_char_p_t data, pinggy_raw_len_t data_len, pinggy_channel_data_free_cb_t free_cb, pinggy_void_p_t user_data);
+
 /**
  * @brief Receives data from the channel.
  *
@@ -1624,6 +1985,75 @@ pinggy_tunnel_channel_send(pinggy_ref_t channel, pinggy_const_char_p_t data, pin
 PINGGY_EXPORT pinggy_raw_len_t
 pinggy_tunnel_channel_recv(pinggy_ref_t channel, pinggy_char_p_t data, pinggy_raw_len_t data_len);
 
+/**
+ * @brief Receives data from the channel without copying it.
+ *
+ * On success `*data` points into the channel's receive buffer. The memory
+ * stays valid until it is handed back with pinggy_tunnel_channel_release.
+ * Several buffers may be borrowed at the same time. Unreleased buffers are
+ * freed with the channel reference.
+ *
+ * @param channel  Reference to the channel object.
+ * @param max_len  Maximum number of bytes to borrow.
+ * @param data     Receives the pointer to the borrowed data.
+ * @return         Number of bytes borrowed, or negative value on error.
+ */
+PINGGY_EXPORT pinggy_raw_len_t
+pinggy_tunnel_channel_recv_borrow(pinggy_ref_t channel, pinggy_raw_len_t max_len, pinggy_const_char_p_t *data);
+
+/**
+ * @brief Releases a buffer borrowed with pinggy_tunnel_channel_recv_borrow.
+ *
+ * @param channel Reference to the channel object.
+ * @param data    Pointer returned by pinggy_tunnel_channel_recv_borrow.
+ * @return        pinggy_true on success, pinggy_false if data was not borrowed from this channel.
+ */
+PINGGY_EXPORT pinggy_bool_t
+pinggy_tunnel_channel_release(pinggy_ref_t channel, pinggy_const_char_p_t data);
+
+/**
+ * @brief Sends data from several buffers to the channel as one write.
+ *
+ * Sends as much of the buffers, in order, as the channel can take now.
+ *
+ * @param channel   Reference to the channel object.
+ * @param iov       Array of buffers to send.
+ * @param iov_count Number of entries in iov.
+ * @return          Number of bytes sent, or negative value on error.
+ */
+PINGGY_EXPORT pinggy_raw_len_t
+pinggy_tunnel_channel_sendv(pinggy_ref_t channel, const pinggy_iovec_t *iov, pinggy_uint32_t iov_count);
+
+/**
+ * @brief Receives data from the channel into several buffers.
+ *
+ * The buffers are filled in order, taking as many queued chunks as available,
+ * with a single call into the tunnel.
+ *
+ * @param channel   Reference to the channel object.
+ * @param iov       Array of buffers to fill.
+ * @param iov_count Number of entries in iov.
+ * @return          Total number of bytes received, or the value
+ *                  pinggy_tunnel_channel_recv would return if nothing was received.
+ */
+PINGGY_EXPORT pinggy_raw_len_t
+pinggy_tunnel_channel_recvv(pinggy_ref_t channel, const pinggy_iovec_t *iov, pinggy_uint32_t iov_count);
+
+/**
+ * @brief Checks the readiness of several channels of a tunnel at once.
+ *
+ * The tunnel is locked once for the whole set. Every channel must belong to
+ * `tunnel`. Entries with an invalid channel reference, or a channel of another
+ * tunnel, are reported as neither readable, writable nor connected.
+ *
+ * @param tunnel   Reference to the tunnel object the channels belong to.
+ * @param channels Array of entries, `channel` set by the application.
+ * @param count    Number of entries.
+ * @return         Number of channels that are readable or writable, or negative value on error.
+ */
+PINGGY_EXPORT pinggy_int32_t
+pinggy_tunnel_channels_poll(pinggy_ref_t tunnel, pinggy_channel_poll_t *channels, pinggy_uint32_t count);
+
 /**
  * @brief Checks if the channel has data available to receive.
  *